@@ -0,0 +1,337 @@
+// d3m_bench: Google Benchmark suite for the load/decode/render hot paths.
+//
+// All inputs are synthetic series generated on first use (see synthetic.h),
+// so no patient data is needed. Results go to stdout as JSON by default;
+// to compare two runs:
+//
+//   d3m_bench --benchmark_out=before.json --benchmark_out_format=json
+//   compare.py benchmarks before.json after.json   (from Google Benchmark)
+
+#include "synthetic.h"
+
+#include "dicom/dicom_utils.h"
+#include "dicom/fusion.h"
+#include "dicom/histogram.h"
+#include "dicom/mpr.h"
+#include "dicom/parallel.h"
+#include "dicom/projection.h"
+#include "dicom/roi_stats.h"
+#include "dicom/series_cache.h"
+#include "dicom/series_loader.h"
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+
+#include <benchmark/benchmark.h>
+
+#include <gdcmReader.h>
+
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QGuiApplication>
+#include <QPixmap>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+using d3m::bench::SyntheticSeries;
+
+namespace {
+
+QStringList seriesFiles(const QString& folder) {
+    QDir dir(folder);
+    QStringList files;
+    for (const QString& f : dir.entryList(QDir::Files))
+        files << dir.absoluteFilePath(f);
+    return files;
+}
+
+// Fully decoded volume of a synthetic series, kept for the whole run
+std::shared_ptr<d3m::Volume> loadedVolume(const SyntheticSeries& p) {
+    static std::map<QString, std::shared_ptr<d3m::Volume>> volumes;
+    const QString folder = d3m::bench::syntheticSeries(p);
+    auto& volume = volumes[folder];
+    if (!volume) {
+        std::vector<d3m::SliceInfo> slices;
+        for (const QString& f : seriesFiles(folder)) {
+            if (auto s = d3m::scanSlice(f)) slices.push_back(std::move(*s));
+        }
+        d3m::sortSeries(slices);
+        volume = std::make_shared<d3m::Volume>(slices);
+        for (int z = 0; z < volume->depth(); ++z) volume->loadSlice(z);
+    }
+    return volume;
+}
+
+// -- header scan ----------------------------------------------------------
+
+void BM_ScanSlice(benchmark::State& state) {
+    const QString file = d3m::bench::syntheticSlice({static_cast<int>(state.range(0)), 1});
+    for (auto _ : state)
+        benchmark::DoNotOptimize(d3m::scanSlice(file));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ScanSlice)->Arg(64)->Arg(512)->Arg(2048);
+
+void BM_GetNumericTag(benchmark::State& state) {
+    gdcm::Reader reader;
+    reader.SetFileName(d3m::bench::syntheticSlice({64, 1}).toStdString().c_str());
+    if (!reader.Read()) {
+        state.SkipWithError("cannot read synthetic slice");
+        return;
+    }
+    const gdcm::File& f = reader.GetFile();
+    const gdcm::DataSet& ds = f.GetDataSet();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(d3m::getNumericTag(f, ds, d3m::ImagePositionPatient.group,
+                                                    d3m::ImagePositionPatient.element, 2));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetNumericTag);
+
+// all geometry of a slice in three typed reads
+void BM_ReadTag(benchmark::State& state) {
+    gdcm::Reader reader;
+    reader.SetFileName(d3m::bench::syntheticSlice({64, 1}).toStdString().c_str());
+    if (!reader.Read()) {
+        state.SkipWithError("cannot read synthetic slice");
+        return;
+    }
+    const gdcm::DataSet& ds = reader.GetFile().GetDataSet();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(d3m::readTag<d3m::ImagePositionPatient, double, 3>(ds));
+        benchmark::DoNotOptimize(d3m::readTag<d3m::ImageOrientationPatient, double, 6>(ds));
+        benchmark::DoNotOptimize(d3m::readTag<d3m::Rows, int>(ds));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadTag);
+
+// -- series load (what "Load DICOM Series" does) -------------------------
+
+// arg 0: slices, arg 1: 1 = warm on-disk index, 0 = index removed first
+void BM_SeriesLoad(benchmark::State& state) {
+    const QStringList files = seriesFiles(d3m::bench::syntheticSeries({64, static_cast<int>(state.range(0))}));
+    const bool warm = state.range(1) != 0;
+    const QString indexPath = d3m::SeriesCache(QFileInfo(files.front()).absolutePath()).indexPath();
+
+    d3m::SeriesLoader loader;
+    for (auto _ : state) {
+        if (!warm) {
+            state.PauseTiming();
+            QFile::remove(indexPath);
+            state.ResumeTiming();
+        }
+        QEventLoop loop;
+        QObject::connect(&loader, &d3m::SeriesLoader::finished, &loop, &QEventLoop::quit);
+        loader.start(files);
+        loop.exec();
+        benchmark::DoNotOptimize(loader.takeResult());
+    }
+    state.SetItemsProcessed(state.iterations() * files.size());
+}
+BENCHMARK(BM_SeriesLoad)
+    ->ArgsProduct({{10, 100, 500, 2000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_SortSeries(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    std::vector<d3m::SliceInfo> shuffled(n);
+    for (int i = 0; i < n; ++i) {
+        shuffled[i].instanceNumber = i + 1;
+        shuffled[i].sliceLocation = i;
+        shuffled[i].imagePosZ = i;
+    }
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto stack = shuffled;
+        state.ResumeTiming();
+        d3m::sortSeries(stack);
+        benchmark::DoNotOptimize(stack.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_SortSeries)->Arg(10)->Arg(500)->Arg(2000);
+
+// -- pixel decode (file -> volume slab) ----------------------------------
+
+// arg 0: size, arg 1: bits allocated, arg 2: 1 = JPEG lossless
+void BM_DecodeSlice(benchmark::State& state) {
+    SyntheticSeries p{static_cast<int>(state.range(0)), 1, static_cast<int>(state.range(1))};
+    p.compressed = state.range(2) != 0;
+    auto slice = d3m::scanSlice(d3m::bench::syntheticSlice(p));
+    if (!slice) {
+        state.SkipWithError("cannot scan synthetic slice");
+        return;
+    }
+    const std::vector<d3m::SliceInfo> slices{*slice};
+    for (auto _ : state) {
+        d3m::Volume volume(slices);
+        benchmark::DoNotOptimize(volume.loadSlice(0));
+    }
+    state.SetBytesProcessed(state.iterations() * p.size * p.size * (p.bitsAllocated / 8));
+}
+BENCHMARK(BM_DecodeSlice)
+    ->ArgsProduct({{64, 256, 512, 1024, 2048}, {8, 16}, {0}})
+    ->ArgsProduct({{512, 2048}, {16}, {1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// whole JPEG lossless series; arg 0: 1 = decode on the pool, 0 = one thread
+void BM_DecodeSeriesCompressed(benchmark::State& state) {
+    SyntheticSeries p{512, 64};
+    p.compressed = true;
+    const QString folder = d3m::bench::syntheticSeries(p);
+    std::vector<d3m::SliceInfo> slices;
+    for (const QString& f : seriesFiles(folder)) {
+        if (auto s = d3m::scanSlice(f)) slices.push_back(std::move(*s));
+    }
+    d3m::sortSeries(slices);
+    const bool parallel = state.range(0) != 0;
+    for (auto _ : state) {
+        d3m::Volume volume(slices);
+        const int depth = volume.depth();
+        if (parallel)
+            d3m::parallelFor(0, depth, [&](int b, int e) { for (int z = b; z < e; ++z) volume.loadSlice(z); }, 1);
+        else
+            for (int z = 0; z < depth; ++z) volume.loadSlice(z);
+        benchmark::DoNotOptimize(volume.sliceRef(depth - 1));
+    }
+    state.SetItemsProcessed(state.iterations() * slices.size());
+}
+BENCHMARK(BM_DecodeSeriesCompressed)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// -- window/level and display --------------------------------------------
+
+void BM_WindowLutUpdate(benchmark::State& state) {
+    d3m::WindowLut lut;
+    int center = 40;
+    for (auto _ : state)
+        lut.update(d3m::PixelType::Int16, 1.0, -1024.0, center++ & 1023, 400);
+}
+BENCHMARK(BM_WindowLutUpdate);
+
+void BM_RenderSlice(benchmark::State& state) {
+    auto volume = loadedVolume({static_cast<int>(state.range(0)), 1});
+    d3m::WindowLut lut;
+    lut.update(*volume, 40, 400);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(d3m::renderSlice(*volume, 0, lut));
+    state.SetItemsProcessed(state.iterations() * volume->sliceSize());
+}
+BENCHMARK(BM_RenderSlice)->Arg(64)->Arg(512)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+// renderSlice + QPixmap upload, the per-slice work of showSlice on a cache miss
+void BM_ShowSlicePixmap(benchmark::State& state) {
+    auto volume = loadedVolume({static_cast<int>(state.range(0)), 1});
+    d3m::WindowLut lut;
+    lut.update(*volume, 40, 400);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(QPixmap::fromImage(d3m::renderSlice(*volume, 0, lut)));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShowSlicePixmap)->Arg(64)->Arg(512)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+// arg 0: plane (0 axial, 1 coronal, 2 sagittal)
+void BM_RenderPlane(benchmark::State& state) {
+    auto volume = loadedVolume({512, 200});
+    const auto plane = static_cast<d3m::Plane>(state.range(0));
+    d3m::WindowLut lut;
+    lut.update(*volume, 40, 400);
+    const int index = d3m::planeCount(*volume, plane) / 2;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(d3m::renderPlane(*volume, plane, index, lut));
+}
+BENCHMARK(BM_RenderPlane)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// arg 0: slab thickness, arg 1: mode
+void BM_Projection(benchmark::State& state) {
+    auto volume = loadedVolume({512, 200, 16, true});
+    const auto mode = static_cast<d3m::ProjectionMode>(state.range(1));
+    const int thickness = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(d3m::projectSlab(*volume, d3m::Plane::Axial, 0, thickness, mode));
+    }
+    state.SetBytesProcessed(state.iterations() * volume->sliceSize() * thickness * sizeof(uint16_t));
+}
+BENCHMARK(BM_Projection)
+    ->ArgsProduct({{10, 200}, {0, 1, 2}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// arg 0: ROI edge (pixels), arg 1: slices
+void BM_RoiStats(benchmark::State& state) {
+    auto volume = loadedVolume({512, 200, 16, true});
+    const int edge = static_cast<int>(state.range(0));
+    const d3m::RoiBox box{100, 100, 100 + edge, 100 + edge, 0, static_cast<int>(state.range(1))};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(d3m::computeRoiStats(*volume, box));
+    state.SetItemsProcessed(state.iterations() * edge * edge * state.range(1));
+}
+BENCHMARK(BM_RoiStats)
+    ->ArgsProduct({{32, 256}, {1, 200}})
+    ->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// Counting one decoded slice into the series histogram (paid on the decode
+// threads), and the auto window read back off it
+void BM_HistogramSlice(benchmark::State& state) {
+    auto volume = loadedVolume({static_cast<int>(state.range(0)), 1, 16, true});
+    d3m::ValueHistogram histogram;
+    histogram.reset(true);
+    const d3m::Volume::SliceRef pixels = volume->sliceRef(0);
+    for (auto _ : state)
+        histogram.addSlice(pixels.get(), volume->sliceSize());
+    state.SetItemsProcessed(state.iterations() * volume->sliceSize());
+}
+BENCHMARK(BM_HistogramSlice)->Arg(512)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+void BM_AutoWindow(benchmark::State& state) {
+    auto volume = loadedVolume({512, 200, 16, true});
+    int center = 0, width = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(d3m::autoWindow(*volume, center, width));
+}
+BENCHMARK(BM_AutoWindow)->Unit(benchmark::kMicrosecond);
+
+// A slice with another series resampled, color-mapped and blended over it;
+// compare with BM_RenderSlice at 512
+void BM_RenderFusedSlice(benchmark::State& state) {
+    auto base = loadedVolume({512, 64, 16, true});
+    auto overlay = loadedVolume({static_cast<int>(state.range(0)), 64});
+    d3m::WindowLut baseLut, overlayLut;
+    baseLut.update(*base, 40, 400);
+    overlayLut.update(*overlay, 2000, 4000);
+    d3m::FusionLut fusion;
+    fusion.update(d3m::Colormap::Hot, 0.6);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(d3m::renderFusedSlice(*base, 32, baseLut, *overlay, overlayLut, fusion));
+    state.SetItemsProcessed(state.iterations() * base->sliceSize());
+}
+BENCHMARK(BM_RenderFusedSlice)->Arg(128)->Arg(512)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // QPixmap needs a GUI application, but no display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    // keep the series index of the synthetic folders out of the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+
+    // JSON unless asked otherwise; later flags on the command line win
+    std::vector<char*> args(argv, argv + argc);
+    char jsonFormat[] = "--benchmark_format=json";
+    args.insert(args.begin() + 1, jsonFormat);
+    int count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
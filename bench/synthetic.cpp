@@ -0,0 +1,143 @@
+#include "synthetic.h"
+
+#include <gdcmAttribute.h>
+#include <gdcmImageChangeTransferSyntax.h>
+#include <gdcmImageWriter.h>
+#include <gdcmMediaStorage.h>
+#include <gdcmUIDGenerator.h>
+
+#include <QDir>
+#include <QTemporaryDir>
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace d3m::bench {
+
+static QTemporaryDir& scratchDir() {
+    static QTemporaryDir dir;
+    return dir;
+}
+
+static QString folderName(const SyntheticSeries& p) {
+    return QString("s%1_n%2_b%3%4%5").arg(p.size).arg(p.slices).arg(p.bitsAllocated)
+        .arg(p.isSigned ? "_signed" : "").arg(p.compressed ? "_jpegll" : "");
+}
+
+template <typename T>
+static void fillPhantom(std::vector<char>& buffer, const SyntheticSeries& p, int z) {
+    buffer.resize(static_cast<std::size_t>(p.size) * p.size * sizeof(T));
+    T* px = reinterpret_cast<T*>(buffer.data());
+    const double c = (p.size - 1) / 2.0;
+    const double r2 = (p.size * 0.4) * (p.size * 0.4);
+    const double dz = (z - (p.slices - 1) / 2.0) * p.size / std::max(p.slices, 1);
+    const int maxValue = sizeof(T) == 1 ? 255 : (p.isSigned ? 2000 : 4000);
+    for (int y = 0; y < p.size; ++y) {
+        for (int x = 0; x < p.size; ++x) {
+            const double d2 = (x - c) * (x - c) + (y - c) * (y - c) + dz * dz;
+            int v = (x + y) * maxValue / (4 * p.size);
+            if (d2 < r2) v += maxValue / 2;
+            if (p.isSigned) v -= 1000;
+            px[static_cast<std::size_t>(y) * p.size + x] = static_cast<T>(v);
+        }
+    }
+}
+
+static bool writeSlice(const QString& path, const SyntheticSeries& p, int z, const char* seriesUID) {
+    gdcm::ImageWriter writer;
+    gdcm::Image& image = writer.GetImage();
+    image.SetNumberOfDimensions(2);
+    image.SetDimension(0, p.size);
+    image.SetDimension(1, p.size);
+    image.SetPhotometricInterpretation(gdcm::PhotometricInterpretation::MONOCHROME2);
+    image.SetTransferSyntax(gdcm::TransferSyntax::ExplicitVRLittleEndian);
+
+    std::vector<char> pixels;
+    if (p.bitsAllocated == 8) {
+        image.SetPixelFormat(gdcm::PixelFormat::UINT8);
+        fillPhantom<uint8_t>(pixels, p, z);
+    } else if (p.isSigned) {
+        image.SetPixelFormat(gdcm::PixelFormat::INT16);
+        fillPhantom<int16_t>(pixels, p, z);
+    } else {
+        image.SetPixelFormat(gdcm::PixelFormat::UINT16);
+        fillPhantom<uint16_t>(pixels, p, z);
+    }
+
+    const double origin[3] = {-p.size / 2.0, -p.size / 2.0, static_cast<double>(z)};
+    const double cosines[6] = {1, 0, 0, 0, 1, 0};
+    image.SetOrigin(origin);
+    image.SetDirectionCosines(cosines);
+    image.SetSpacing(0, 0.7);
+    image.SetSpacing(1, 0.7);
+    image.SetSpacing(2, 1.0);
+
+    gdcm::DataElement pixelData(gdcm::Tag(0x7fe0, 0x0010));
+    pixelData.SetByteValue(pixels.data(), static_cast<uint32_t>(pixels.size()));
+    image.SetDataElement(pixelData);
+
+    if (p.compressed) {
+        gdcm::ImageChangeTransferSyntax change;
+        change.SetTransferSyntax(gdcm::TransferSyntax::JPEGLosslessProcess14_1);
+        change.SetInput(image);
+        if (!change.Change()) return false;
+        writer.SetImage(change.GetOutput());
+    }
+
+    gdcm::DataSet& ds = writer.GetFile().GetDataSet();
+    const gdcm::MediaStorage ms = gdcm::MediaStorage::CTImageStorage;
+    gdcm::DataElement sopClass(gdcm::Tag(0x0008, 0x0016));
+    sopClass.SetByteValue(ms.GetString(), static_cast<uint32_t>(std::strlen(ms.GetString())));
+    sopClass.SetVR(gdcm::Attribute<0x0008, 0x0016>::GetVR());
+    ds.Insert(sopClass);
+
+    gdcm::UIDGenerator uid;
+    gdcm::Attribute<0x0008, 0x0018> sopInstance = {uid.Generate()};
+    gdcm::Attribute<0x0008, 0x0060> modality = {"CT"};
+    gdcm::Attribute<0x0008, 0x103e> description = {"synthetic"};
+    gdcm::Attribute<0x0020, 0x000e> series = {seriesUID};
+    gdcm::Attribute<0x0020, 0x0013> instance = {z + 1};
+    gdcm::Attribute<0x0018, 0x0050> thickness = {1.0};
+    ds.Replace(sopInstance.GetAsDataElement());
+    ds.Replace(modality.GetAsDataElement());
+    ds.Replace(description.GetAsDataElement());
+    ds.Replace(series.GetAsDataElement());
+    ds.Replace(instance.GetAsDataElement());
+    ds.Replace(thickness.GetAsDataElement());
+
+    writer.SetFileName(path.toStdString().c_str());
+    return writer.Write();
+}
+
+QString syntheticSeries(const SyntheticSeries& params) {
+    static std::mutex mutex;
+    static std::map<QString, QString> written;
+
+    std::lock_guard lock(mutex);
+    const QString name = folderName(params);
+    if (auto it = written.find(name); it != written.end()) return it->second;
+
+    QDir root(scratchDir().path());
+    root.mkpath(name);
+    const QString folder = root.filePath(name);
+
+    gdcm::UIDGenerator uid;
+    const std::string seriesUID = uid.Generate();
+    for (int z = 0; z < params.slices; ++z) {
+        const QString path = QDir(folder).filePath(QString("slice%1.dcm").arg(z, 5, 10, QChar('0')));
+        if (!writeSlice(path, params, z, seriesUID.c_str())) return QString();
+    }
+    written.emplace(name, folder);
+    return folder;
+}
+
+QString syntheticSlice(const SyntheticSeries& params, int z) {
+    const QString folder = syntheticSeries(params);
+    if (folder.isEmpty()) return folder;
+    return QDir(folder).filePath(QString("slice%1.dcm").arg(z, 5, 10, QChar('0')));
+}
+
+} // namespace d3m::bench
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QString>
+
+namespace d3m::bench {
+
+struct SyntheticSeries {
+    int size = 512;             // rows = columns
+    int slices = 10;
+    int bitsAllocated = 16;     // 8 or 16
+    bool isSigned = false;      // 16-bit only: CT-like int16 with intercept 0
+    bool compressed = false;    // JPEG lossless instead of explicit VR little endian
+};
+
+// Folder holding a generated series with these parameters. Series are
+// written once per run into a temporary directory and reused by every
+// benchmark that asks for the same parameters. Pixels are a smooth
+// phantom (a sphere in a gradient) so compression and windowing behave
+// roughly like real data.
+QString syntheticSeries(const SyntheticSeries& params);
+
+// One file of such a series
+QString syntheticSlice(const SyntheticSeries& params, int z = 0);
+
+} // namespace d3m::bench
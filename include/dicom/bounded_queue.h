@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace d3m {
+
+// Fixed-capacity multi-producer/multi-consumer queue for pipeline stages.
+// push() blocks while the queue is full, so a fast stage can never run
+// further ahead of a slow one than the capacity. close() wakes everybody:
+// consumers drain what is left and then get nullopt, producers get false.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+
+    bool push(T value) {
+        std::unique_lock lock(m_mutex);
+        m_notFull.wait(lock, [&] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) return false;
+        m_items.push_back(std::move(value));
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock lock(m_mutex);
+        m_notEmpty.wait(lock, [&] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) return std::nullopt;
+        T value = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_notFull.notify_one();
+        return value;
+    }
+
+    // Non-blocking pop: nullopt when nothing is queued right now
+    std::optional<T> tryPop() {
+        std::unique_lock lock(m_mutex);
+        if (m_items.empty()) return std::nullopt;
+        T value = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_notFull.notify_one();
+        return value;
+    }
+
+    std::size_t size() const {
+        std::lock_guard lock(m_mutex);
+        return m_items.size();
+    }
+
+    void close() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_closed = true;
+        }
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+private:
+    const std::size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T> m_items;
+    bool m_closed = false;
+};
+
+} // namespace d3m
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "dicom/bounded_queue.h"
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace d3m {
+
+// Frame pacing of the current (or last) playback
+struct CineStats {
+    int64_t presented = 0;
+    int64_t dropped = 0;      // frames skipped because presentation fell behind
+    int64_t stalls = 0;       // ticks with no frame ready (producer behind)
+    double meanIntervalMs = 0.0;
+    double maxIntervalMs = 0.0;
+};
+
+// Plays a volume at a fixed frame rate. A producer thread decodes and
+// windows slices ahead into a small ring of frames; a precise timer on the
+// owner's thread takes them off in order and emits frameReady(). When the
+// timer fires late, frames that are already overdue are dropped rather than
+// shown late, so playback keeps wall-clock time. A new window while playing
+// is swapped in for the producer and the frames windowed with the old one
+// are drained, without stopping playback.
+class CinePlayer : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int MaxFps = 60;
+    static constexpr std::size_t RingSize = 16;
+
+    explicit CinePlayer(QObject* parent = nullptr);
+    ~CinePlayer() override;
+
+    // Plays from slice `start`, looping, with a copy of the LUT
+    void start(const std::shared_ptr<Volume>& volume, int start, const WindowLut& lut, int fps);
+    void stop();
+    bool isPlaying() const { return m_timer.isActive(); }
+
+    // Windows the frames from the one after the frame on screen with a copy
+    // of `lut`; frames already windowed with the old one are dropped
+    void setLut(const WindowLut& lut);
+
+    void setFps(int fps);
+    int fps() const { return m_fps; }
+
+    const CineStats& stats() const { return m_stats; }
+
+signals:
+    void frameReady(int z, const QImage& image);
+
+private:
+    struct Frame {
+        int z = 0;
+        uint64_t lutVersion = 0;
+        QImage image;
+    };
+
+    void onTick();
+    std::shared_ptr<const WindowLut> currentLut();
+
+    QThreadPool m_producer;
+    // the producer's LUT, swapped whole; the version tells its frames apart
+    std::mutex m_lutMutex;
+    std::shared_ptr<const WindowLut> m_lut;
+    std::atomic<uint64_t> m_lutVersion{0};
+    std::atomic<int> m_resumeAt{0}; // where the producer goes on after a swap
+    int m_depth = 0;
+    int m_lastShown = 0;
+    std::shared_ptr<BoundedQueue<Frame>> m_ring;
+    std::atomic<bool> m_stop{false};
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    int m_fps = 15;
+    int64_t m_due = 0; // frames that should have been shown since the clock started
+    qint64 m_lastPresentNs = 0;
+    CineStats m_stats;
+};
+
+} // namespace d3m
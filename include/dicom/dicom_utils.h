@@ -1,8 +1,20 @@
 #pragma once
+#include "dicom/tag_store.h"
+
 #include <cstdint>
 #include <QImage>
 #include <QString>
 
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace gdcm {
+class File;
+class DataSet;
+}
+
 namespace d3m {
 
 struct Tag {
@@ -26,20 +38,48 @@ inline constexpr Tag ImagePositionPatient       = {0x0020, 0x0032};
 inline constexpr Tag ImageOrientationPatient    = {0x0020, 0x0037};
 inline constexpr Tag SliceThickness             = {0x0018, 0x0050};
 inline constexpr Tag PixelSpacing               = {0x0028, 0x0030};
+inline constexpr Tag Rows                       = {0x0028, 0x0010};
+inline constexpr Tag Columns                    = {0x0028, 0x0011};
+
+// Multi-frame / Enhanced objects: geometry per frame in functional groups
+inline constexpr Tag NumberOfFrames             = {0x0028, 0x0008};
+inline constexpr Tag SharedFunctionalGroups     = {0x5200, 0x9229};
+inline constexpr Tag PerFrameFunctionalGroups   = {0x5200, 0x9230};
+inline constexpr Tag PixelMeasuresSequence      = {0x0028, 0x9110};
+inline constexpr Tag PlanePositionSequence      = {0x0020, 0x9113};
+inline constexpr Tag PlaneOrientationSequence   = {0x0020, 0x9116};
+inline constexpr Tag PixelValueTransformSequence = {0x0028, 0x9145};
+inline constexpr Tag FrameVoiLutSequence        = {0x0028, 0x9132};
+
+// Pixel Format
+inline constexpr Tag BitsAllocated              = {0x0028, 0x0100};
+inline constexpr Tag BitsStored                 = {0x0028, 0x0101};
+inline constexpr Tag PixelRepresentation        = {0x0028, 0x0103};
+inline constexpr Tag RescaleIntercept           = {0x0028, 0x1052};
+inline constexpr Tag RescaleSlope               = {0x0028, 0x1053};
+inline constexpr Tag WindowCenter               = {0x0028, 0x1050};
+inline constexpr Tag WindowWidth                = {0x0028, 0x1051};
+inline constexpr Tag WindowExplanation          = {0x0028, 0x1055};
 
 // Acquisition Timing
 inline constexpr Tag AcquisitionTime            = {0x0008, 0x0032};
 inline constexpr Tag TriggerTime                = {0x0018, 0x1060};
 inline constexpr Tag SliceLocation              = {0x0018, 0x1041};
+inline constexpr Tag EchoNumbers                = {0x0018, 0x0086};
+inline constexpr Tag TemporalPositionIdentifier = {0x0020, 0x0100};
+
+// Pixel Data, header scans stop right before it
+inline constexpr Tag PixelData                  = {0x7FE0, 0x0010};
 
 struct SliceInfo {
-    QImage image;       // the slice image (converted to QImage)
     QString filePath;   // path to the DICOM file
     QString seriesUID;
     QString seriesDesc;
 
     // geometry
     int instanceNumber = -1;
+    int rows = 0;
+    int columns = 0;
     double pixelSpacingX = 0.0;
     double pixelSpacingY = 0.0;
     double sliceThickness = 0.0;
@@ -48,6 +88,15 @@ struct SliceInfo {
     double imagePosZ = 0.0;
     double sliceLocation = 0;
 
+    // acquisitions that share one series UID: echoes and dynamic phases
+    int echoNumber = 0;
+    int temporalPosition = 0;
+    double triggerTime = 0.0; // ms
+
+    // multi-frame files give one SliceInfo per frame
+    int frameIndex = 0;
+    int numberOfFrames = 1;
+
     // orientation cosines
     double rowCosX = 0.0;
     double rowCosY = 0.0;
@@ -56,9 +105,65 @@ struct SliceInfo {
     double colCosY = 0.0;
     double colCosZ = 0.0;
 
-    // optionaL window/level used to render this slice
+    // pixel format, stored value -> modality value (e.g. HU) via slope/intercept
+    int bitsAllocated = 16;
+    int bitsStored = 16;
+    int pixelRepresentation = 0; // 0 = unsigned, 1 = signed
+    double rescaleSlope = 1.0;
+    double rescaleIntercept = 0.0;
+    QString transferSyntaxUID;
+
+    // window/level the file suggests (the first, if it lists several); -1 if none
     int windowCenter = -1;
     int windowWidth = -1;
+
+    // all header elements, parsed once at scan time for the metadata dock
+    TagStore tags;
 };
 
+// Parses up to `count` values of a numeric element straight from its bytes:
+// decimal strings (DS/IS, split on '\\') or binary US/SS/UL/SL/FL/FD, with the
+// VR taken from the dictionary for implicit VR files. Nothing is allocated.
+// Returns how many values were read; missing or unparsable ones are not written.
+int readNumbers(const gdcm::DataSet& ds, Tag tag, double* out, int count);
+
+// Typed access by the constants above, e.g.
+//   auto pos = readTag<ImagePositionPatient, double, 3>(ds);
+// Values the element does not have are `fallback`.
+template <Tag T, typename V = double, std::size_t N = 1>
+std::array<V, N> readTag(const gdcm::DataSet& ds, V fallback = V{}) {
+    std::array<double, N> raw;
+    raw.fill(static_cast<double>(fallback));
+    readNumbers(ds, T, raw.data(), static_cast<int>(N));
+    std::array<V, N> values;
+    for (std::size_t i = 0; i < N; ++i)
+        values[i] = static_cast<V>(raw[i]);
+    return values;
+}
+
+// Reads one value of a numeric tag by number, 0 if missing (see readNumbers)
+double getNumericTag(const gdcm::File& f,
+                     const gdcm::DataSet& ds,
+                     uint16_t group,
+                     uint16_t element,
+                     int index = 0);
+
+// Native little endian transfer syntaxes, whose pixel data can be read as is
+inline constexpr const char* ImplicitVRLittleEndianUID = "1.2.840.10008.1.2";
+inline constexpr const char* ExplicitVRLittleEndianUID = "1.2.840.10008.1.2.1";
+
+inline bool isUncompressedLittleEndian(const QString& transferSyntaxUID) {
+    return transferSyntaxUID == QLatin1String(ImplicitVRLittleEndianUID) ||
+           transferSyntaxUID == QLatin1String(ExplicitVRLittleEndianUID);
+}
+
+// Header-only scan: parses tags up to Pixel Data, pixels are decoded later
+// into a Volume. Multi-frame files give one entry per frame, with the
+// geometry of Enhanced objects taken from the shared and per-frame
+// functional groups. Empty if the file is not DICOM. Safe to call from any thread.
+std::vector<SliceInfo> scanFile(const QString& filePath);
+
+// scanFile for files known to hold a single image (first frame otherwise)
+std::optional<SliceInfo> scanSlice(const QString& filePath);
+
 } // namespace dicom
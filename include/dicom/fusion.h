@@ -0,0 +1,64 @@
+#pragma once
+
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+
+#include <QImage>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3m {
+
+enum class Colormap {
+    Hot,        // black - red - yellow - white, for PET/SPECT
+    Rainbow,
+    Gray,
+};
+
+// Windowed overlay level (0..255) -> blend weights for one colormap and
+// opacity. Levels below the threshold are fully transparent, so the
+// overlay's background never tints the base image. Like WindowLut, the
+// table only changes when its parameters do.
+class FusionLut {
+public:
+    static constexpr std::size_t Size = 256;
+
+    FusionLut();
+
+    // Returns false (and does nothing) when nothing changed
+    bool update(Colormap colormap, double opacity, int threshold = 1);
+
+    // Blends n overlay levels over n gray base pixels into RGB32
+    void blend(const uchar* base, const uchar* overlay, uint32_t* dst, std::size_t n) const;
+
+    double opacity() const { return m_opacity; }
+
+private:
+    // color premultiplied by alpha, and 256 - alpha for the base
+    struct Entry {
+        uint16_t r = 0;
+        uint16_t g = 0;
+        uint16_t b = 0;
+        uint16_t inverse = 256;
+    };
+
+    std::vector<Entry> m_table;
+    bool m_valid = false;
+    Colormap m_colormap = Colormap::Hot;
+    double m_opacity = 0.0;
+    int m_threshold = 0;
+};
+
+// Slice z of `base` with `overlay` fused over it, as RGB32 with the same
+// row order as renderSlice. The overlay is resampled (trilinear, on its
+// stored values) into the base slice's patient-space geometry, so series of
+// any resolution and orientation line up; overlay slices the plane crosses
+// are decoded on demand, in parallel. Outside the overlay the base shows
+// through. A null image means the geometries cannot be related (degenerate
+// orientation).
+QImage renderFusedSlice(const Volume& base, int z, const WindowLut& baseLut,
+                        Volume& overlay, const WindowLut& overlayLut, const FusionLut& fusion);
+
+} // namespace d3m
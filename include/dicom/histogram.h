@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace d3m {
+
+class Volume;
+
+// Count of every stored value of a volume, filled in slice by slice as the
+// slices decode (on whatever threads decode them), so a series histogram is
+// never a separate pass over the pixels. Signed data is counted by value,
+// so the counts run from the lowest value up either way. Thread-safe.
+class ValueHistogram {
+public:
+    static constexpr std::size_t Size = 65536;
+
+    void reset(bool isSigned);
+    void addSlice(const uint16_t* data, std::size_t n);
+
+    uint64_t total() const;
+    // slices counted so far
+    int slices() const;
+    // Stored value below which `fraction` (0..1) of the counted voxels lie
+    int percentile(double fraction) const;
+    // Lowest and highest stored value counted; false while empty
+    bool range(int& lo, int& hi) const;
+    // `bins` equal bins over [lo, hi] of stored values, for display
+    std::vector<int64_t> binned(int bins, int lo, int hi) const;
+
+private:
+    int valueAt(std::size_t index) const { return m_signed ? static_cast<int>(index) - 32768 : static_cast<int>(index); }
+
+    mutable std::mutex m_mutex;
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total = 0;
+    int m_slices = 0;
+    bool m_signed = false;
+};
+
+// Window (modality units) spanning the [low, high] percentiles of what the
+// volume has decoded so far. False if nothing is decoded yet.
+bool autoWindow(const Volume& volume, int& center, int& width, double low = 0.005, double high = 0.995);
+
+} // namespace d3m
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <utility>
+
+namespace d3m {
+
+// Byte-budgeted LRU cache. Every entry carries a cost (its size in bytes);
+// inserting past the budget evicts least recently used entries, but never the
+// entry just inserted. Hit/miss counters are kept for tuning the budget.
+// Not thread-safe: meant to be owned and used by a single (GUI) thread.
+template <typename Key, typename Value>
+class LruCache {
+public:
+    explicit LruCache(std::size_t budgetBytes) : m_budget(budgetBytes) {}
+
+    // Looks the key up and marks it most recently used; counts a hit or a miss
+    Value* find(const Key& key) {
+        auto it = m_index.find(key);
+        if (it == m_index.end()) {
+            ++m_misses;
+            return nullptr;
+        }
+        ++m_hits;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return &it->second->value;
+    }
+
+    bool contains(const Key& key) const { return m_index.count(key) != 0; }
+
+    void insert(const Key& key, Value value, std::size_t cost) {
+        erase(key);
+        m_entries.push_front(Entry{key, std::move(value), cost});
+        m_index.emplace(key, m_entries.begin());
+        m_bytes += cost;
+        evict();
+    }
+
+    void erase(const Key& key) {
+        auto it = m_index.find(key);
+        if (it == m_index.end()) return;
+        m_bytes -= it->second->cost;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    void clear() {
+        m_entries.clear();
+        m_index.clear();
+        m_bytes = 0;
+    }
+
+    void setBudget(std::size_t budgetBytes) {
+        m_budget = budgetBytes;
+        evict();
+    }
+
+    std::size_t budget() const { return m_budget; }
+    std::size_t bytes() const { return m_bytes; }
+    std::size_t size() const { return m_entries.size(); }
+    uint64_t hits() const { return m_hits; }
+    uint64_t misses() const { return m_misses; }
+    double hitRate() const {
+        const uint64_t total = m_hits + m_misses;
+        return total ? static_cast<double>(m_hits) / total : 0.0;
+    }
+    void resetStats() { m_hits = m_misses = 0; }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        std::size_t cost;
+    };
+    using Iterator = typename std::list<Entry>::iterator;
+
+    void evict() {
+        while (m_bytes > m_budget && m_entries.size() > 1) {
+            Entry& e = m_entries.back();
+            m_bytes -= e.cost;
+            m_index.erase(e.key);
+            m_entries.pop_back();
+        }
+    }
+
+    std::size_t m_budget;
+    std::size_t m_bytes = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    std::list<Entry> m_entries; // front = most recently used
+    std::map<Key, Iterator> m_index;
+};
+
+} // namespace d3m
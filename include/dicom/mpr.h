@@ -0,0 +1,48 @@
+#pragma once
+
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+
+#include <QImage>
+
+namespace d3m {
+
+// Orthogonal planes of the volume's index space. Axial is the acquired
+// plane; for a sagittal or coronal acquisition the names follow the stack,
+// not the patient (planeName gives the patient's).
+enum class Plane {
+    Axial,      // x/y at slice z
+    Coronal,    // x/z at row y
+    Sagittal,   // y/z at column x
+};
+
+struct Voxel {
+    int x = 0;
+    int y = 0;
+    int z = 0;
+};
+
+// Image size of a plane and how many planes there are along its normal
+int planeWidth(const Volume& volume, Plane plane);
+int planeHeight(const Volume& volume, Plane plane);
+int planeCount(const Volume& volume, Plane plane);
+int planeIndex(Plane plane, const Voxel& voxel);
+
+// Patient-space name of a plane, from the axis its normal runs along most:
+// "Axial", "Coronal" or "Sagittal", "Oblique" if no axis dominates
+QString planeName(const Volume& volume, Plane plane);
+
+// Height/width of one plane pixel in mm, for non-square display
+double planeAspect(const Volume& volume, Plane plane);
+
+// Plane image pixel <-> voxel. Plane images are shown with the last row of
+// the slab (or the last slice) at the top, like renderSlice.
+void voxelToPlane(const Volume& volume, Plane plane, const Voxel& voxel, int& u, int& v);
+void planeToVoxel(const Volume& volume, Plane plane, int u, int v, Voxel& voxel);
+
+// Reformat plane `index` straight through the LUT into an 8-bit image.
+// Rows are filled in parallel; coronal reads whole slab rows, sagittal reads
+// one strided column per output row. Slices that are not loaded stay black.
+QImage renderPlane(const Volume& volume, Plane plane, int index, const WindowLut& lut);
+
+} // namespace d3m
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <functional>
+
+namespace d3m {
+
+// Runs body(chunkBegin, chunkEnd) over [begin, end) in chunks of `grain`
+// (0 = pick one from the pool size) on the global QThreadPool and returns
+// when all chunks are done. The calling thread takes chunks too, and helper
+// tasks that never got a thread are withdrawn again, so this is safe to call
+// from inside pool threads.
+void parallelFor(int begin, int end, const std::function<void(int, int)>& body, int grain = 0);
+
+} // namespace d3m
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "dicom/mpr.h"
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+
+#include <QImage>
+
+#include <cstdint>
+#include <vector>
+
+namespace d3m {
+
+enum class ProjectionMode {
+    Mip,        // maximum along the ray
+    MinIp,      // minimum along the ray
+    Average,    // mean along the ray
+};
+
+// Planes [first, last) along the normal of `plane` that a slab of `thickness`
+// planes centred on `center` covers, clamped to the volume
+void slabRange(const Volume& volume, Plane plane, int center, int thickness, int& first, int& last);
+
+// Project the stored values of planes [first, last) along the plane normal.
+// The result is in plane image layout (see renderPlane), one stored value
+// per pixel, so it goes through the same LUT as a slice. Signed data is
+// compared as signed. Slices that are not loaded are left out; coronal and
+// sagittal rows of such slices are zero.
+std::vector<uint16_t> projectSlab(const Volume& volume, Plane plane, int first, int last, ProjectionMode mode);
+
+// Window a slab projection into an 8-bit image; rows with no data stay black
+QImage renderProjection(const Volume& volume, Plane plane, int center, int thickness,
+                        ProjectionMode mode, const WindowLut& lut);
+
+} // namespace d3m
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "dicom/volume.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace d3m {
+
+// Box of voxels in volume coordinates: columns [x0, x1), rows [y0, y1) of
+// slices [z0, z1). Rows are stored rows, i.e. not flipped like the images.
+struct RoiBox {
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+    int z0 = 0;
+    int z1 = 1;
+};
+
+// Statistics of the modality values (rescaled, e.g. HU) inside a RoiBox
+struct RoiStats {
+    int64_t count = 0;          // voxels measured
+    int slices = 0;             // slices of the box that were loaded
+    double mean = 0.0;
+    double sd = 0.0;            // population standard deviation
+    double min = 0.0;
+    double max = 0.0;
+    double areaMm2 = 0.0;       // in-plane area of the box
+    double volumeMm3 = 0.0;     // area x loaded slices x slice spacing
+    // equal-width bins over [min, max]; bin i starts at min + i * binWidth
+    std::vector<int64_t> histogram;
+    double binWidth = 0.0;
+};
+
+// Measures the box from the stored values, in parallel over its rows.
+// Slices that are not loaded are left out. Sums and extremes are kept in
+// stored units and rescaled once at the end.
+RoiStats computeRoiStats(const Volume& volume, RoiBox box, int bins = 64);
+
+} // namespace d3m
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "dicom/dicom_utils.h"
+
+#include <QFileInfo>
+#include <QHash>
+#include <QString>
+
+#include <vector>
+
+namespace d3m {
+
+// On-disk index of scanned headers for one folder, stored in the user's cache
+// directory. Entries are keyed by file path and only reused while the file's
+// size and modification time match, so reopening an unchanged folder needs
+// no DICOM parsing at all. Files that did not parse are remembered too.
+class SeriesCache {
+public:
+    struct Entry {
+        QString filePath;
+        qint64 size = 0;
+        qint64 mtime = 0;                   // ms since epoch
+        std::vector<SliceInfo> slices;      // one per frame; empty: not a readable DICOM file
+    };
+
+    explicit SeriesCache(const QString& folder);
+
+    // Reads the index file; a missing or outdated file just leaves it empty
+    bool load();
+    // Replaces the index file with exactly the given entries
+    bool save(const std::vector<Entry>& entries) const;
+
+    // Cached entry for the file if it has not changed since; safe to call
+    // concurrently once load() has returned
+    const Entry* find(const QFileInfo& file) const;
+
+    QString indexPath() const { return m_indexPath; }
+
+private:
+    QString m_indexPath;
+    QHash<QString, Entry> m_entries;
+};
+
+} // namespace d3m
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "dicom/dicom_utils.h"
+#include "dicom/series_cache.h"
+#include "dicom/series_sorter.h"
+#include "dicom/tag_search_index.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace d3m {
+
+// Scans the headers of a list of DICOM files on a worker pool; pixel data is
+// decoded later, on demand (see decodeSlice). Workers pull the next file
+// from a shared cursor, so a slow (e.g. compressed) file never stalls the
+// others. Files whose size and mtime match the folder's on-disk index
+// (SeriesCache) are not parsed again. Slices go into a SeriesSorter as each
+// file is done, so they are split and ordered while the scan runs; the last
+// worker to finish takes the stacks, indexes them off the GUI thread and
+// emits finished().
+// While the scan runs, seriesFound() announces new slices in batches (the
+// first file right away, then a few times a second), so the GUI can show
+// stacks as they grow. append() scans more files into the same result, e.g.
+// ones a modality is still writing into a watched folder; a file scanned
+// before is scanned again and replaces its old slices.
+class SeriesLoader : public QObject {
+    Q_OBJECT
+public:
+    explicit SeriesLoader(QObject* parent = nullptr);
+    ~SeriesLoader() override;
+
+    void start(const QStringList& files);
+    // Scans more files of the same folder; the next result holds the old and
+    // the new slices, files already scanned are replaced. False while a run
+    // is still going.
+    bool append(const QStringList& files);
+    // Stops the run after its current files and drops what it found that was
+    // not taken yet
+    void cancel();
+    bool isRunning() const;
+
+    // Result of the most recent run (every stack since start(), appended files
+    // included), empty if it is still running, was cancelled or has already
+    // been taken.
+    std::optional<SeriesMap> takeResult();
+    // What the stacks got since the last call: the new slices and where they
+    // go, whole stacks only where one was split or reordered (see
+    // SeriesSorter::takeChanged); only valid during a run
+    StackUpdates takeUpdates();
+    // Tag search index over the same result, built alongside it
+    std::unique_ptr<TagSearchIndex> takeSearchIndex();
+    // Files of the last run that had to be parsed (not in the index or changed)
+    int scannedFiles() const;
+
+signals:
+    void progress(int done, int total);
+    void seriesFound();
+    void finished();
+    void cancelled();
+
+private:
+    void runWorker();
+    bool mergeResults(); // false if the run was cancelled
+
+    static constexpr qint64 BatchIntervalMs = 250;
+
+    QThreadPool m_pool;
+    QStringList m_files;
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_lastBatch{-1}; // m_clock time of the last seriesFound()
+
+    std::atomic<int> m_next{0};
+    std::atomic<int> m_done{0};
+    std::atomic<int> m_scanned{0};
+    std::atomic<int> m_activeWorkers{0};
+    std::atomic<bool> m_running{false}; // until the last worker has merged
+    std::atomic<bool> m_cancel{false};
+
+    std::mutex m_mutex;
+    std::unique_ptr<SeriesCache> m_cache;
+    std::unique_ptr<std::once_flag> m_cacheLoaded;
+    std::vector<std::vector<SeriesCache::Entry>> m_partials; // one per worker, for the index file
+    std::vector<SeriesCache::Entry> m_entries; // of every run since start()
+    std::set<QString> m_replaced; // files of this run that an earlier run scanned
+    SeriesSorter m_sorter;
+    std::optional<SeriesMap> m_result;
+    std::unique_ptr<TagSearchIndex> m_index;
+};
+
+} // namespace d3m
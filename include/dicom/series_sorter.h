@@ -0,0 +1,121 @@
+#pragma once
+
+#include "dicom/dicom_utils.h"
+
+#include <QString>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace d3m {
+
+using SeriesMap = std::map<QString, std::vector<SliceInfo>>;
+
+// Display order of one stack: position along the slice normal (from the
+// orientation cosines, so oblique, sagittal and coronal stacks sort too),
+// then trigger time, instance number and frame index. Runs in the direction
+// of increasing instance number where the series has them.
+void sortSeries(std::vector<SliceInfo>& stack);
+
+// Spacing of a sorted stack along its normal
+struct StackGeometry {
+    double spacing = 0.0;     // median distance between neighbours (mm)
+    double minSpacing = 0.0;
+    double maxSpacing = 0.0;
+    int gaps = 0;             // neighbours more than 1.5x the median apart
+    int duplicates = 0;       // neighbours at the same position (not counted as spacings)
+    bool uniform = true;      // every spacing within 10% of the median
+};
+
+StackGeometry analyzeStack(const std::vector<SliceInfo>& stack);
+
+// What one stack got since it was last handed out: only its new slices and
+// where they go, or (reset) the whole stack again because it was split,
+// reordered or lost slices. A reset with no slices means the stack is gone.
+struct StackUpdate {
+    bool reset = false;
+    std::vector<SliceInfo> slices;
+    std::vector<int> positions; // of each new slice in the grown stack, ascending
+};
+
+using StackUpdates = std::map<QString, StackUpdate>;
+
+// Brings a stack handed out before up to date with an update of it
+void applyStackUpdate(std::vector<SliceInfo>& stack, StackUpdate&& update);
+
+// Sorts slices into display stacks as they arrive, so a large study is in
+// order the moment its last file is scanned. A series UID is split into
+// sub-series by orientation, echo number and temporal position, and stacks
+// that repeat every position equally often (dynamic phases without temporal
+// tags) are split into one stack per phase; a stack with only some positions
+// repeated stays whole (see StackGeometry::duplicates). Each add() is O(log n).
+// Not thread-safe; the loader serializes access.
+class SeriesSorter {
+public:
+    void add(SliceInfo slice);
+    // Drops every slice of a file, e.g. one that changed on disk and is
+    // about to be added again
+    void removeFile(const QString& filePath);
+    std::size_t size() const { return m_count; }
+
+    // The stacks, keyed by series UID; sub-series get "/<part>" appended to
+    // the key and a readable suffix on their description. Leaves the sorter empty.
+    SeriesMap take();
+    // Copies of all stacks; the sorter keeps its slices, so it can go on
+    // sorting files that arrive later
+    SeriesMap stacks();
+    // What changed since the last stacks() or takeChanged(): copies of the
+    // new slices only, unless a stack has to be handed out whole again
+    StackUpdates takeChanged();
+    // Shares equal tag values across the slices of each series (internTags)
+    void internTags();
+
+private:
+    using Vec3 = std::array<double, 3>;
+
+    struct Orientation {
+        Vec3 row;
+        Vec3 col;
+        Vec3 normal;
+    };
+
+    // position along the normal in µm, so equal positions compare equal
+    using Order = std::tuple<int64_t, double, int, int>;
+    using GroupKey = std::tuple<int, int, int>; // orientation, echo, temporal position
+
+    struct Entry {
+        SliceInfo slice;
+        int handed = -1; // stack it was last handed out in, -1 if new
+    };
+
+    struct Series {
+        std::vector<Orientation> orientations;
+        std::map<GroupKey, std::multimap<Order, Entry>> groups;
+        // the stacks as last handed out, to tell growth from reordering
+        std::vector<QString> handedKeys;
+        std::vector<bool> handedReversed;
+        bool removed = false; // lost slices that were handed out
+    };
+
+    // one stack of a series, in display order, pointing into the sorter
+    struct Stack {
+        QString key;
+        QString suffix;
+        bool reversed = false;
+        std::vector<Entry*> entries;
+    };
+
+    static std::vector<Stack> layout(const QString& uid, Series& series);
+    static void handOut(Series& series, std::vector<Stack>& stacks, bool copy, SeriesMap& result);
+
+    std::map<QString, Series> m_series;
+    std::set<QString> m_changed;
+    std::size_t m_count = 0;
+};
+
+} // namespace d3m
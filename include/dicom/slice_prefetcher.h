@@ -0,0 +1,46 @@
+#pragma once
+
+#include "dicom/volume.h"
+
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace d3m {
+
+// Decodes slices around the one being viewed on a small background pool,
+// furthest ahead in the scroll direction and a few behind. A new request
+// drops whatever the previous one had not started yet.
+// Compressed series are CPU bound in the codec rather than bound by the
+// disk, so they get every core but the GUI thread's.
+class SlicePrefetcher {
+public:
+    explicit SlicePrefetcher(int ahead = 8, int behind = 2);
+    ~SlicePrefetcher();
+
+    // direction: +1 scrolling forward, -1 backward, 0 unknown
+    void request(const std::shared_ptr<Volume>& volume, int center, int direction);
+    // every slice of the volume, nearest to center first (reformatting needs them
+    // all); for a frame-cached volume, as many as stay decoded
+    void requestAll(const std::shared_ptr<Volume>& volume, int center);
+    // slices [first, last), nearest to center first (a projection slab)
+    void requestRange(const std::shared_ptr<Volume>& volume, int first, int last, int center);
+    void cancel();
+
+    void setAhead(int ahead) { m_ahead = ahead; }
+    void setBehind(int behind) { m_behind = behind; }
+
+private:
+    void enqueue(const std::shared_ptr<Volume>& volume, const std::vector<int>& order);
+
+    QThreadPool m_pool;
+    int m_readThreads;
+    int m_decodeThreads;
+    std::atomic<uint64_t> m_generation{0};
+    int m_ahead;
+    int m_behind;
+};
+
+} // namespace d3m
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "dicom/dicom_utils.h"
+
+#include <QHash>
+#include <QString>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace d3m {
+
+// Search index over the tag stores of all loaded series.
+//
+// Every distinct (tag, value) pair of a series becomes one document that
+// lists the slices carrying it, so a tag that is identical across a
+// 2000-slice series is indexed once. Documents are found through a trigram
+// index over "(gggg,eeee) keyword value" (lower case). Two query forms:
+//   "thick"                   substring over tag, keyword and value
+//   "SliceThickness = 5"      exact field match, numeric when both sides are numbers
+// Typing more characters onto the previous substring query only re-checks
+// the previous hits.
+class TagSearchIndex {
+public:
+    struct Document {
+        int series = 0;             // index into seriesKeys()
+        uint32_t tag = 0;
+        QString value;
+        QString text;               // lower-cased search text
+        std::vector<int> slices;    // slice indices within the series, ascending
+    };
+
+    void clear();
+    void addSeries(const QString& seriesKey, const std::vector<SliceInfo>& slices);
+
+    // Returns matching document ids, in index order
+    const std::vector<int>& search(const QString& query);
+
+    const Document& document(int id) const { return m_docs[id]; }
+    const QString& seriesKey(int series) const { return m_seriesKeys[series]; }
+    std::size_t documentCount() const { return m_docs.size(); }
+
+private:
+    bool parseField(const QString& query, uint32_t& tag, QString& value) const;
+    std::vector<int> searchSubstring(const QString& needle) const;
+    std::vector<int> searchField(uint32_t tag, const QString& value) const;
+
+    std::vector<QString> m_seriesKeys;
+    std::vector<Document> m_docs;
+    std::unordered_map<uint64_t, std::vector<int>> m_trigrams;
+    std::unordered_map<uint32_t, std::vector<int>> m_byTag;
+    QHash<QString, uint32_t> m_keywords;    // lower-cased keyword -> tag
+
+    // last substring query, for incremental refinement
+    QString m_lastQuery;
+    bool m_lastIsSubstring = false;
+    std::vector<int> m_result;
+};
+
+} // namespace d3m
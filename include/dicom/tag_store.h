@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QSet>
+#include <QString>
+
+#include <cstdint>
+#include <vector>
+
+namespace gdcm {
+class File;
+}
+
+namespace d3m {
+
+// One data element of a slice as shown in the metadata dock
+struct TagEntry {
+    uint32_t tag = 0;   // (group << 16) | element
+    QString value;
+};
+
+// Top-level data elements of one slice, in dataset (tag) order
+using TagStore = std::vector<TagEntry>;
+
+inline uint32_t tagKey(uint16_t group, uint16_t element) {
+    return (uint32_t(group) << 16) | element;
+}
+
+// Value of one element of the store, empty if it has none
+QString tagValue(const TagStore& tags, uint32_t tag);
+
+// Collects all top-level elements of a parsed file as strings
+TagStore collectTags(const gdcm::File& file);
+
+// Makes equal values across the given stores share one string buffer.
+// Most tags are identical for every slice of a series, so interning them
+// once per series keeps the per-slice stores small.
+void internTags(std::vector<TagStore*>& stores);
+
+// Dictionary lookups (public dictionary), e.g. "(0018,0050)", "SliceThickness", "DS"
+QString tagString(uint32_t tag);
+QString tagKeyword(uint32_t tag);
+QString tagVR(uint32_t tag);
+
+} // namespace d3m
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace d3m {
+
+// Duration percentiles of one scope name, in milliseconds
+struct TraceStats {
+    int count = 0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Process-wide recorder for D3M_TRACE_SCOPE. Every thread writes completed
+// scopes into its own ring (the last Capacity events, grown as needed), so
+// recording is two clock reads and an uncontended lock, cheap enough to
+// leave on. Readers (overlay, export) lock one ring at a time.
+// A ring outlives its thread and goes to the next new one, so there are
+// never more rings than threads alive at once.
+// Scope names are not copied: they must be string literals.
+class Tracer {
+public:
+    static constexpr std::size_t Capacity = 8192;
+
+    static Tracer& instance();
+    static int64_t now(); // ns on a steady clock
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+
+    void record(const char* name, int64_t begin, int64_t end);
+    void clear();
+
+    // Over the events of the last `windowMs` milliseconds still buffered
+    TraceStats stats(const char* name, int windowMs = 10000) const;
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto) of everything buffered
+    bool exportChromeTrace(const QString& path) const;
+
+private:
+    struct Event {
+        const char* name;
+        int64_t begin;
+        int64_t end;
+    };
+    struct ThreadBuffer {
+        int tid = 0;
+        QString name;
+        mutable std::mutex mutex;
+        std::vector<Event> events; // ring, `next` is the oldest once full
+        std::size_t next = 0;
+    };
+
+    struct BufferOwner;
+
+    Tracer() = default;
+    ThreadBuffer& threadBuffer();
+    void releaseBuffer(ThreadBuffer* buffer);
+
+    std::atomic<bool> m_enabled{true};
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers; // never freed, see m_free
+    std::vector<ThreadBuffer*> m_free; // of exited threads, reused by new ones
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : m_name(Tracer::instance().isEnabled() ? name : nullptr), m_begin(m_name ? Tracer::now() : 0) {}
+    ~TraceScope() {
+        if (m_name) Tracer::instance().record(m_name, m_begin, Tracer::now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    int64_t m_begin;
+};
+
+} // namespace d3m
+
+#define D3M_TRACE_CONCAT_(a, b) a##b
+#define D3M_TRACE_CONCAT(a, b) D3M_TRACE_CONCAT_(a, b)
+
+// Times the rest of the enclosing block under `name` (a string literal)
+#ifdef D3M_DISABLE_TRACING
+#define D3M_TRACE_SCOPE(name) do {} while (0)
+#else
+#define D3M_TRACE_SCOPE(name) d3m::TraceScope D3M_TRACE_CONCAT(d3mTraceScope_, __LINE__)(name)
+#endif
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "dicom/dicom_utils.h"
+#include "dicom/histogram.h"
+
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <vector>
+
+namespace gdcm {
+class ImageRegionReader;
+}
+
+namespace d3m {
+
+enum class PixelType {
+    UInt16,
+    Int16,
+};
+
+using Vec3 = std::array<double, 3>;
+
+// Native (stored) pixels of a whole series in one contiguous, aligned
+// allocation, slice-major: voxel (x, y, z) is at sliceRef(z)[y*w + x].
+// 8-bit data is widened to 16 bits so every consumer deals with one layout.
+// All slices share one rescale; slices whose own slope, intercept or pixel
+// representation differ are requantized to it when decoded.
+// A slice may also be one frame of a multi-frame file; only that frame is
+// ever read from the file.
+// Slices start out empty and are decoded from their files with loadSlice(),
+// which may be called concurrently (e.g. by the prefetcher and the GUI).
+// Multi-frame series too large to keep whole (long cine loops) get one
+// buffer per decoded frame instead of the slab, and only the most recently
+// used frames up to FrameCacheBudget stay decoded; the rest are evicted and
+// decoded again when needed. Pixels are read through sliceRef(), which keeps
+// the slice alive while it is held.
+// A stack that is still arriving grows in place with insertSlices(): slices
+// keep the storage they were decoded into, only the stack order is updated.
+class Volume {
+public:
+    static constexpr std::size_t Alignment = 64;
+    static constexpr std::size_t FrameCacheBudget = std::size_t(512) << 20;
+
+    // Decoded pixels of one slice, valid while held; null if not loaded
+    using SliceRef = std::shared_ptr<const uint16_t[]>;
+
+    explicit Volume(const std::vector<SliceInfo>& slices);
+    ~Volume();
+
+    Volume(const Volume&) = delete;
+    Volume& operator=(const Volume&) = delete;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int depth() const { return m_depth; }
+    std::size_t sliceSize() const { return static_cast<std::size_t>(m_width) * m_height; }
+    std::size_t sizeInBytes() const { return sliceSize() * m_depth * sizeof(uint16_t); }
+    // most the volume ever holds decoded at once, what a cache should charge for it
+    std::size_t maxResidentBytes() const { return m_frameCached ? FrameCacheBudget : sizeInBytes(); }
+    bool isFrameCached() const { return m_frameCached; }
+
+    PixelType pixelType() const { return m_pixelType; }
+    // true if any slice has to go through a codec (JPEG, JPEG-LS, J2K, RLE..)
+    bool isCompressed() const { return m_compressed; }
+    // modality value = stored value * slope + intercept, for every slice
+    double rescaleSlope() const { return m_rescaleSlope; }
+    double rescaleIntercept() const { return m_rescaleIntercept; }
+
+    // patient-space geometry (mm), taken from the SliceInfo headers
+    double spacingX() const { return m_spacing[0]; }
+    double spacingY() const { return m_spacing[1]; }
+    double spacingZ() const { return m_spacing[2]; }
+    const Vec3& origin() const { return m_origin; }
+    const Vec3& rowCosines() const { return m_rowCos; }
+    const Vec3& colCosines() const { return m_colCos; }
+    const Vec3& normal() const { return m_normal; }
+    // patient-space offset from slice z to z+1, in stack order (so it may
+    // point against the normal, and carries any gantry tilt)
+    const Vec3& sliceStep() const { return m_sliceStep; }
+
+    SliceRef sliceRef(int z) const;
+
+    // stored values of every slice decoded so far
+    const ValueHistogram& histogram() const { return m_histogram; }
+
+    const QString& filePath(int z) const { return m_sources[m_slot[z]].filePath; }
+    bool isSliceLoaded(int z) const { return m_state[m_slot[z]].load(std::memory_order_acquire) == Ready; }
+    // slices decoded and not evicted
+    int loadedSlices() const { return m_loadedCount.load(); }
+
+    // Decode slice z from its file straight into its slab (no-op if loaded).
+    // If another thread is already decoding z, waits for it instead. In a
+    // frame-cached volume this may evict the least recently used frames.
+    bool loadSlice(int z);
+
+    // Takes over the decoded slices of `other` that come from the same file
+    // and frame, e.g. when a stack grew and its volume is rebuilt. Nothing
+    // is copied if the pixel formats differ, nor from files in `changed`
+    // (rewritten on disk since other decoded them). Returns the slices taken.
+    int adoptSlices(const Volume& other, const std::set<QString>& changed = {});
+
+    // Inserts slices into the stack, slices[i] ending up at positions[i]
+    // (ascending, indices into the grown stack); what was decoded stays
+    // decoded. Waits for decodes in flight. False, and nothing changes, if
+    // a slice has another size or values the volume's rescale cannot hold;
+    // the volume has to be rebuilt then. Like filePath() and
+    // isSliceLoaded(), only for the thread that owns the volume.
+    bool insertSlices(const std::vector<int>& positions, const std::vector<SliceInfo>& slices);
+
+private:
+    enum SliceState : uint8_t {
+        Empty,
+        Loading,
+        Ready,
+    };
+
+    // where a slice comes from and how its stored values are encoded; these
+    // may differ between slices (PET sets Rescale Slope per slice)
+    struct Source {
+        QString filePath;
+        QString transferSyntaxUID;
+        int frameIndex = 0;
+        int numberOfFrames = 1;
+        int bitsAllocated = 16;
+        int bitsStored = 16;
+        bool isSigned = false;
+        double rescaleSlope = 1.0;
+        double rescaleIntercept = 0.0;
+        Vec3 position = {0.0, 0.0, 0.0};
+    };
+
+    // Per-slice storage is indexed by slot, the order a slice joined the
+    // volume in; m_slot maps stack order to slots.
+    static Source sourceOf(const SliceInfo& slice);
+    std::shared_ptr<uint16_t[]> allocateSlab(std::size_t slices) const;
+    void updateStackGeometry();
+    bool fitsRescale(const SliceInfo& slice) const;
+    uint16_t* slice(int slot) { return m_frameCached ? m_frames[slot].get() : m_data.get() + sliceSize() * slot; }
+    void publish(int slot, bool ok);
+    bool decodeInto(int slot);
+    bool readMapped(int slot);
+    bool readWhole(int slot);
+    bool readFrameRegion(int slot);
+    bool readFrame(gdcm::ImageRegionReader& reader, int slot);
+    void chooseCommonRescale();
+    void finishSlice(int slot);
+    std::unique_ptr<gdcm::ImageRegionReader> takeReader(const QString& filePath);
+    void returnReader(const QString& filePath, std::unique_ptr<gdcm::ImageRegionReader> reader);
+
+    struct AlignedDelete {
+        void operator()(uint16_t* p) const { ::operator delete(p, std::align_val_t{Alignment}); }
+    };
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_depth = 0;
+    PixelType m_pixelType = PixelType::UInt16;
+    bool m_compressed = false;
+    double m_rescaleSlope = 1.0;
+    double m_rescaleIntercept = 0.0;
+    Vec3 m_spacing = {1.0, 1.0, 1.0};
+    Vec3 m_origin = {0.0, 0.0, 0.0};
+    Vec3 m_rowCos = {1.0, 0.0, 0.0};
+    Vec3 m_colCos = {0.0, 1.0, 0.0};
+    Vec3 m_normal = {0.0, 0.0, 1.0};
+    Vec3 m_sliceStep = {0.0, 0.0, 1.0};
+    double m_sliceThickness = 0.0;
+
+    std::shared_ptr<uint16_t[]> m_data;
+    std::size_t m_capacity = 0; // slots the slab and the state have room for
+    std::vector<Source> m_sources;
+    std::vector<int> m_slot;
+    std::unique_ptr<std::atomic<uint8_t>[]> m_state;
+    int m_loading = 0; // slices being decoded, guarded by m_mutex
+    std::atomic<int> m_loadedCount{0};
+    ValueHistogram m_histogram;
+    std::vector<uint8_t> m_counted; // slices already in the histogram (frames may decode again)
+    // frame-cached volumes: one buffer per decoded frame, most recently used first
+    bool m_frameCached = false;
+    std::vector<std::shared_ptr<uint16_t[]>> m_frames;
+    mutable std::list<int> m_lru;
+    mutable std::vector<std::list<int>::iterator> m_lruPos;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_loadedCv;
+    // idle readers of multi-frame files, header already parsed
+    std::mutex m_readerMutex;
+    std::multimap<QString, std::unique_ptr<gdcm::ImageRegionReader>> m_readers;
+};
+
+} // namespace d3m
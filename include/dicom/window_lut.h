@@ -0,0 +1,47 @@
+#pragma once
+
+#include "dicom/volume.h"
+
+#include <QImage>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace d3m {
+
+// Stored 16-bit value -> 8-bit display value for one window/level.
+// The table has an entry for every possible stored value (signed data is
+// indexed by its bit pattern), so rendering is a single lookup per pixel and
+// the rescale + window math only runs when the window actually changes.
+class WindowLut {
+public:
+    static constexpr std::size_t Size = 65536;
+
+    WindowLut();
+
+    // Rebuild for the given window (modality units) and volume pixel format.
+    // Returns false (and does nothing) when nothing changed.
+    bool update(const Volume& volume, int windowCenter, int windowWidth);
+    bool update(PixelType type, double slope, double intercept, int windowCenter, int windowWidth);
+
+    void apply(const uint16_t* src, uchar* dst, std::size_t n) const;
+    const uint8_t* table() const { return m_table.data(); }
+
+    int windowCenter() const { return m_windowCenter; }
+    int windowWidth() const { return m_windowWidth; }
+
+private:
+    std::vector<uint8_t> m_table;
+    bool m_valid = false;
+    PixelType m_type = PixelType::UInt16;
+    double m_slope = 1.0;
+    double m_intercept = 0.0;
+    int m_windowCenter = 0;
+    int m_windowWidth = 0;
+};
+
+// Window a loaded slice of the volume into an 8-bit image
+QImage renderSlice(const Volume& volume, int z, const WindowLut& lut);
+
+} // namespace d3m
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "dicom/dicom_utils.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <cmath>
+#include <optional>
+#include <vector>
+
+namespace d3m {
+
+// Common CT windows in HU
+struct WindowPreset {
+    const char* name;
+    int center;
+    int width;
+};
+
+inline constexpr WindowPreset WindowPresets[] = {
+    {"soft-tissue",  40,  400},
+    {"brain",        40,   80},
+    {"subdural",     75,  215},
+    {"stroke",       40,   40},
+    {"lung",       -600, 1500},
+    {"mediastinum",  50,  350},
+    {"liver",        60,  160},
+    {"bone",        400, 1800},
+};
+
+inline std::optional<WindowPreset> findWindowPreset(const QString& name) {
+    for (const WindowPreset& p : WindowPresets) {
+        if (name.compare(QLatin1String(p.name), Qt::CaseInsensitive) == 0)
+            return p;
+    }
+    return std::nullopt;
+}
+
+// A window offered for one series, from its own tags or a preset
+struct NamedWindow {
+    QString name;
+    int center;
+    int width;
+};
+
+// Windows the slice's file lists: (0028,1050)/(0028,1051) pair up value by
+// value, named by (0028,1055) where the file explains them
+inline std::vector<NamedWindow> sliceWindows(const SliceInfo& slice) {
+    const QStringList centers = tagValue(slice.tags, tagKey(WindowCenter.group, WindowCenter.element)).split('\\');
+    const QStringList widths = tagValue(slice.tags, tagKey(WindowWidth.group, WindowWidth.element)).split('\\');
+    const QStringList names = tagValue(slice.tags, tagKey(WindowExplanation.group, WindowExplanation.element)).split('\\');
+    std::vector<NamedWindow> windows;
+    for (int i = 0; i < std::min(centers.size(), widths.size()); ++i) {
+        bool okCenter = false, okWidth = false;
+        const double center = centers[i].trimmed().toDouble(&okCenter);
+        const double width = widths[i].trimmed().toDouble(&okWidth);
+        if (!okCenter || !okWidth || width < 1.0) continue;
+        QString name = i < names.size() ? names[i].trimmed() : QString();
+        if (name.isEmpty()) name = QString("DICOM %1").arg(i + 1);
+        windows.push_back({name, static_cast<int>(std::lround(center)), static_cast<int>(std::lround(width))});
+    }
+    // no tag store (e.g. a cached frame): the parsed first window
+    if (windows.empty() && slice.windowWidth >= 1)
+        windows.push_back({"DICOM", slice.windowCenter, slice.windowWidth});
+    return windows;
+}
+
+// Built-in presets that make sense for a modality (the HU windows are CT only)
+inline std::vector<NamedWindow> modalityWindows(const QString& modality) {
+    std::vector<NamedWindow> windows;
+    if (modality.trimmed().compare(QLatin1String("CT"), Qt::CaseInsensitive) != 0) return windows;
+    for (const WindowPreset& p : WindowPresets)
+        windows.push_back({QString::fromLatin1(p.name), p.center, p.width});
+    return windows;
+}
+
+} // namespace d3m
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QWidget>
+
+#include <cstdint>
+#include <vector>
+
+// Bar chart of a histogram over [min, min + bins * binWidth), with an
+// optional highlighted range (e.g. the current window) drawn behind it
+class HistogramWidget : public QWidget {
+    Q_OBJECT
+public:
+    explicit HistogramWidget(QWidget* parent = nullptr);
+
+    void setHistogram(std::vector<int64_t> bins, double min, double binWidth);
+    void setRange(double low, double high);
+    void clear();
+
+    QSize sizeHint() const override { return {200, 80}; }
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    std::vector<int64_t> m_bins;
+    double m_min = 0.0;
+    double m_binWidth = 1.0;
+    bool m_hasRange = false;
+    double m_low = 0.0;
+    double m_high = 0.0;
+};
@@ -5,22 +5,47 @@
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsRectItem>
+#include <QGraphicsLineItem>
 #include <QTreeWidget>
 #include <QComboBox>
 
+class TiledImageItem;
+
 class ImageView : public QGraphicsView {
     Q_OBJECT
 public:
+    // images above this many pixels are drawn from tiles (see TiledImageItem)
+    static constexpr qint64 TiledPixels = qint64(2048) * 2048;
+    static bool wantsTiles(const QSize& size);
+
     explicit ImageView(QWidget* parent = nullptr);
 
+    // new image: drops overlay and ROIs, fits the view
     void loadBaseImage(const QImage& img);
+    void loadBaseImage(const QPixmap& pixmap);
+    // swap the base pixmap only, keeping overlay, ROIs, zoom and pan (next slice,
+    // window/level change); the view is only refitted when the size changes
+    void updateBaseImage(const QImage& img);
+    void updateBaseImage(const QPixmap& pixmap);
     void loadOverlayImage(const QImage& img);
     void setOverlayOpacity(qreal o);
     void setOverlayVisible(bool v);
     void setDrawingEnabled(bool enabled);
+    void clearRois();
+    // height/width of one image pixel, for planes with non-square voxels
+    void setPixelAspect(qreal aspect);
+    // crosshair in image pixel coordinates; while enabled, left click/drag moves it
+    void setCrosshairEnabled(bool enabled);
+    void setCrosshair(const QPointF& imagePos);
 
 signals:
     void roiFinished(const QRectF& roiSceneCoords);
+    // while the ROI is dragged and once more when it is released, in image pixel coordinates
+    void roiChanged(const QRectF& imageRect);
+    // right-button drag, in viewport pixels since the last event
+    void windowLevelDragged(int dx, int dy);
+    // left click/drag in crosshair mode, in image pixel coordinates
+    void crosshairMoved(const QPointF& imagePos);
 
 protected:
     void mousePressEvent(QMouseEvent* event) override;
@@ -28,10 +53,26 @@ protected:
     void mouseReleaseEvent(QMouseEvent* event) override;
 
 private:
+    void setBase(QGraphicsItem* item);
+    void resetGeometry();
+    void updateCrosshair();
+    void emitCrosshairAt(const QPoint& viewPos);
+
     QGraphicsScene* m_scene = nullptr;
-    QGraphicsPixmapItem* m_baseItem = nullptr;
+    QGraphicsPixmapItem* m_pixmapItem = nullptr;
+    TiledImageItem* m_tiledItem = nullptr;
+    QGraphicsItem* m_baseItem = nullptr; // whichever of the two shows the image
+    QSize m_imageSize;
     QGraphicsPixmapItem* m_overlayItem = nullptr;
     QGraphicsRectItem* m_currentRect = nullptr;
     bool m_drawingEnabled = false;
     QPointF m_startScenePoint;
+    bool m_windowLevelDrag = false;
+    QPoint m_lastDragPos;
+    qreal m_pixelAspect = 1.0;
+    bool m_crosshairEnabled = false;
+    bool m_crosshairDrag = false;
+    QPointF m_crosshairPos;
+    QGraphicsLineItem* m_hLine = nullptr;
+    QGraphicsLineItem* m_vLine = nullptr;
 };
\ No newline at end of file
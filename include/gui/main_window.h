@@ -1,16 +1,48 @@
 #pragma once
 
+#include "dicom/cine_player.h"
 #include "dicom/dicom_utils.h"
+#include "dicom/fusion.h"
+#include "dicom/lru_cache.h"
+#include "dicom/mpr.h"
+#include "dicom/projection.h"
+#include "dicom/roi_stats.h"
+#include "dicom/series_loader.h"
+#include "dicom/series_sorter.h"
+#include "dicom/slice_prefetcher.h"
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+#include "gui/histogram_widget.h"
 #include "gui/image_view.h"
+#include "gui/metadata_model.h"
 
 #include <QMainWindow>
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsRectItem>
-#include <QTreeWidget>
+#include <QTreeView>
 #include <QComboBox>
+#include <QLabel>
+#include <QListWidget>
+#include <QPixmap>
+#include <QSlider>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QCheckBox>
+#include <QSpinBox>
+#include <QStackedWidget>
+#include <QTimer>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QPair>
 
+#include <array>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <utility>
 #include <vector>
 
 class MainWindow : public QMainWindow {
@@ -29,20 +61,130 @@ private slots:
     void onStartDrawROI();
     void onClearROI();
     void onROIFinished(const QRectF& rect);
+    void onSeriesLoadProgress(int done, int total);
+    void onSeriesFound();
+    void onSeriesLoaded();
+    void onSeriesLoadCancelled();
+    void onToggleMpr(bool checked);
+    void onTogglePerfOverlay(bool checked);
+    void onExportTrace();
+    void onToggleCine(bool checked);
 
 private:
     QSlider* sliceSlider;
+    QSlider* wcSlider = nullptr;
+    QSlider* wwSlider = nullptr;
+    int windowCenter = 40;  // just guessing
+    int windowWidth = 400;  // just guessing
+    d3m::WindowLut windowLut;
     std::map<QString, std::vector<d3m::SliceInfo>> seriesMap;
+    // decoded series and rendered slices, both bounded and evicted LRU
+    static constexpr std::size_t VolumeCacheBudget = std::size_t(2048) << 20;
+    static constexpr std::size_t PixmapCacheBudget = std::size_t(256) << 20;
+    d3m::LruCache<QString, std::shared_ptr<d3m::Volume>> volumeCache{VolumeCacheBudget};
+    d3m::LruCache<std::pair<QString, int>, QPixmap> pixmapCache{PixmapCacheBudget};
+    d3m::SlicePrefetcher prefetcher;
+    int lastShownSlice = -1;
+    d3m::StackGeometry currentGeometry; // of the series on screen, for spacing warnings
     QLineEdit* metaFilter = nullptr;
-    QTreeWidget* metaTree = nullptr;
+    QTreeView* metaView = nullptr;
+    MetadataModel* metaModel = nullptr;
+    QListWidget* searchResults = nullptr;
+    QLabel* searchStatus = nullptr;
+    std::unique_ptr<d3m::TagSearchIndex> searchIndex;
+    std::vector<int> searchHits;
+    static constexpr int MaxSearchResults = 500;
     std::vector<QString> dicomFiles;
     int currentSlice = 0;
     QString currentSeriesUID = 0;
     ImageView* m_view = nullptr;
     QComboBox* seriesCombo = nullptr;
+    d3m::SeriesLoader* seriesLoader = nullptr;
+    QProgressBar* loadProgress = nullptr;
+    QPushButton* cancelLoadBtn = nullptr;
+    // the loaded folder, optionally watched for files that are still arriving
+    static constexpr int WatchSettleMs = 1000;
+    QCheckBox* watchToggle = nullptr;
+    QFileSystemWatcher* folderWatcher = nullptr;
+    QTimer* watchTimer = nullptr;
+    QString loadedFolder;
+    // size and mtime of every file handed to the loader, to spot rewrites
+    QHash<QString, QPair<qint64, qint64>> knownFiles;
+    std::set<QString> changedFiles; // rewritten files being scanned again
+    bool settlePending = false;     // files of the listing were still being written
+    // MPR mode: axial/coronal/sagittal views around one voxel of the current series
+    QStackedWidget* viewStack = nullptr;
+    std::array<ImageView*, 3> mprViews{};
+    std::array<QLabel*, 3> mprTitles{}; // patient-space name of each pane's plane
+    QCheckBox* mprToggle = nullptr;
+    QTimer* mprRefresh = nullptr;
+    bool mprMode = false;
+    d3m::Voxel mprCursor;
+    int mprLoadedShown = -1;
+    // thick-slab projection instead of single planes, when set
+    QComboBox* projectionCombo = nullptr;
+    QSpinBox* slabSpin = nullptr;
+    std::optional<d3m::ProjectionMode> projectionMode;
+    int slabThickness = 1;
+    QTimer* slabRefresh = nullptr;
+    int slabLoadedShown = -1; // slab slices decoded when it was last drawn
+    // cine playback of the current series, pre-windowed frames swapped into the view
+    d3m::CinePlayer* cine = nullptr;
+    QPushButton* cineBtn = nullptr;
+    QSpinBox* fpsSpin = nullptr;
+    // window presets of the current series and its histogram, shaded by the window
+    QComboBox* windowCombo = nullptr;
+    HistogramWidget* seriesHistogram = nullptr;
+    int histogramShown = -1; // loaded slices when the histogram was last drawn
+    // "Auto" taken from part of the series: the rest decodes in the
+    // background and Auto is applied again once the histogram covers it
+    QTimer* autoRefresh = nullptr;
+    QPoint autoShown;           // center, width Auto last set
+    bool autoRequested = false; // the rest is queued with the prefetcher
+    // fusion: another series of the folder resampled into this one's geometry,
+    // color-mapped and blended into the base image
+    QComboBox* fusionCombo = nullptr;
+    QComboBox* colormapCombo = nullptr;
+    QString fusionSeriesUID;
+    std::shared_ptr<d3m::Volume> fusionVolume;
+    d3m::WindowLut fusionWindowLut;
+    d3m::FusionLut fusionLut;
+    double overlayOpacity = 0.6;
+    bool overlayVisible = true;
+    // ROI measurements from the stored values, live while the rectangle is dragged
+    QCheckBox* roi3dToggle = nullptr;
+    QLabel* roiLabel = nullptr;
+    HistogramWidget* roiHistogram = nullptr;
+    std::optional<QRectF> roiRect; // image pixel coordinates
+    // a 3D ROI's slab decodes in the background, measured as its slices come in
+    QTimer* roiRefresh = nullptr;
+    std::pair<int, int> roiRequested{-1, -1}; // slab last handed to the prefetcher
+    int roiSlicesShown = -1; // slab slices measured when the stats were last shown
+    // timings from the trace scopes, drawn over the views
+    QLabel* perfOverlay = nullptr;
+    QTimer* perfTimer = nullptr;
     bool showSlice(int index);
+    std::shared_ptr<d3m::Volume> volumeFor(const QString& seriesUID);
+    void mergeSeries(d3m::StackUpdates&& updates);
+    void scanWatchedFolder();
+    void setWindowLevel(int center, int width);
+    void renderCurrentSlice();
+    void startMpr();
+    void updateMprViews();
+    QImage renderPlaneImage(d3m::Volume& volume, d3m::Plane plane, int index);
+    void updatePerfOverlay();
+    std::optional<d3m::RoiStats> updateRoiStats();
+    bool populateWindowPresets();
+    void applyWindowPreset(int index);
+    void updateSeriesHistogram(const d3m::Volume& volume);
+    void widenWindowRange(double lo, double hi);
+    bool fusing() const;
+    void setFusionSeries(int index);
+    void startCine();
+    void showCineFrame(int z, const QImage& image);
+    void onMprCrosshair(d3m::Plane plane, const QPointF& imagePos);
     QWidget* createToolBarWidget();
-    void loadDicomMetadata(const QString& file);
     void filterMetadata(const QString& text);
+    void applyMetadataFilter();
     void extractSliceMetadata(const QString& file);
 };
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "dicom/tag_store.h"
+
+#include <QAbstractTableModel>
+
+// Flat Tag / Value / VR table over a slice's TagStore. Switching to another
+// slice of the same series only signals the rows whose value differs.
+class MetadataModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    enum Column {
+        TagColumn,
+        ValueColumn,
+        VRColumn,
+        ColumnCount,
+    };
+
+    explicit MetadataModel(QObject* parent = nullptr);
+
+    void setTags(const d3m::TagStore& tags);
+    const d3m::TagStore& tags() const { return m_tags; }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    bool sameLayout(const d3m::TagStore& tags) const;
+
+    d3m::TagStore m_tags;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "dicom/lru_cache.h"
+
+#include <QGraphicsItem>
+#include <QImage>
+#include <QPixmap>
+
+#include <cstddef>
+#include <tuple>
+#include <vector>
+
+// Image item for pictures too large to upload and smooth-scale in one piece
+// (digital X-ray, mammography, large secondary captures). It keeps a mip
+// pyramid of the image, built a level at a time as zooming out needs it,
+// and paints only the tiles in the exposed rect, from the level closest to
+// the current zoom. Tiles become pixmaps on first paint and live in a byte
+// budgeted LRU, so pixmap memory follows what is on screen rather than the
+// image size.
+class TiledImageItem : public QGraphicsItem {
+public:
+    static constexpr int TileSize = 256;
+    static constexpr std::size_t TileCacheBudget = std::size_t(64) << 20;
+
+    explicit TiledImageItem(QGraphicsItem* parent = nullptr);
+
+    void setImage(const QImage& image);
+    const QImage& image() const { return m_levels.front(); }
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    using TileKey = std::tuple<int, int, int>; // level, tile x, tile y
+
+    int levelFor(qreal lod);
+    const QImage& level(int index);
+    const QPixmap& tile(int level, int tx, int ty);
+
+    std::vector<QImage> m_levels; // [0] is the full image
+    d3m::LruCache<TileKey, QPixmap> m_tiles{TileCacheBudget};
+};
@@ -0,0 +1,135 @@
+#include "dicom/cine_player.h"
+#include "dicom/trace.h"
+
+#include <algorithm>
+#include <optional>
+
+namespace d3m {
+
+CinePlayer::CinePlayer(QObject* parent) : QObject(parent) {
+    m_producer.setMaxThreadCount(1);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &CinePlayer::onTick);
+}
+
+CinePlayer::~CinePlayer() {
+    stop();
+}
+
+void CinePlayer::start(const std::shared_ptr<Volume>& volume, int start, const WindowLut& lut, int fps) {
+    stop();
+    if (!volume || volume->depth() == 0) return;
+
+    m_stats = {};
+    m_stop = false;
+    m_ring = std::make_shared<BoundedQueue<Frame>>(RingSize);
+    const int depth = volume->depth();
+    start = std::clamp(start, 0, depth - 1);
+    m_depth = depth;
+    m_lastShown = start;
+    {
+        std::lock_guard lock(m_lutMutex);
+        m_lut = std::make_shared<const WindowLut>(lut);
+    }
+
+    // the ring's capacity keeps the producer at most RingSize frames ahead
+    m_producer.start([this, ring = m_ring, volume, start, depth] {
+        uint64_t version = m_lutVersion.load();
+        std::shared_ptr<const WindowLut> lut = currentLut();
+        for (int z = start; !m_stop.load(); z = (z + 1) % depth) {
+            if (m_lutVersion.load() != version) {
+                // a new window: go on from the frame after the one on screen
+                version = m_lutVersion.load();
+                lut = currentLut();
+                z = m_resumeAt.load();
+            }
+            volume->loadSlice(z);
+            if (!ring->push(Frame{z, version, renderSlice(*volume, z, *lut)})) break;
+        }
+    });
+
+    m_fps = std::clamp(fps, 1, MaxFps);
+    m_due = 0;
+    m_lastPresentNs = 0;
+    m_timer.start(1000 / m_fps);
+    m_clock.start();
+}
+
+void CinePlayer::stop() {
+    m_timer.stop();
+    m_stop = true;
+    if (m_ring) m_ring->close();
+    m_producer.waitForDone();
+    m_ring.reset();
+}
+
+std::shared_ptr<const WindowLut> CinePlayer::currentLut() {
+    std::lock_guard lock(m_lutMutex);
+    return m_lut;
+}
+
+void CinePlayer::setLut(const WindowLut& lut) {
+    {
+        std::lock_guard lock(m_lutMutex);
+        m_lut = std::make_shared<const WindowLut>(lut);
+    }
+    if (!isPlaying()) return;
+    m_resumeAt = (m_lastShown + 1) % m_depth;
+    ++m_lutVersion;
+    // a producer blocked on the full ring goes on; a frame it pushes with
+    // the old window is dropped on the next tick
+    while (m_ring->tryPop()) {}
+}
+
+void CinePlayer::setFps(int fps) {
+    m_fps = std::clamp(fps, 1, MaxFps);
+    if (!isPlaying()) return;
+    // pace from now on at the new rate
+    m_timer.setInterval(1000 / m_fps);
+    m_clock.restart();
+    m_due = 0;
+    m_lastPresentNs = 0;
+}
+
+// Frames are due on the wall clock, not per tick: integer timer intervals and
+// late ticks would otherwise drift. Overdue frames are popped and dropped;
+// on an empty ring (a stall) playback resumes from the next frame instead of
+// catching up.
+void CinePlayer::onTick() {
+    D3M_TRACE_SCOPE("cine.present");
+    const qint64 now = m_clock.nsecsElapsed();
+    const int64_t due = now * m_fps / 1000000000 + 1;
+    const int64_t behind = due - m_due;
+    if (behind <= 0) return;
+
+    std::optional<Frame> frame;
+    int64_t taken = 0;
+    const uint64_t version = m_lutVersion.load();
+    while (taken < behind) {
+        auto next = m_ring->tryPop();
+        if (!next) break;
+        if (next->lutVersion != version) continue; // windowed before the last setLut()
+        frame = std::move(next);
+        ++taken;
+    }
+    m_due = due;
+    if (!frame) {
+        ++m_stats.stalls;
+        return;
+    }
+    m_stats.dropped += taken - 1;
+
+    if (m_lastPresentNs > 0) {
+        const double interval = (now - m_lastPresentNs) / 1e6;
+        const auto n = static_cast<double>(m_stats.presented);
+        m_stats.meanIntervalMs += (interval - m_stats.meanIntervalMs) / n;
+        m_stats.maxIntervalMs = std::max(m_stats.maxIntervalMs, interval);
+    }
+    m_lastPresentNs = now;
+    m_lastShown = frame->z;
+    ++m_stats.presented;
+
+    emit frameReady(frame->z, frame->image);
+}
+
+} // namespace d3m
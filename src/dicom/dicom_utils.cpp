@@ -0,0 +1,253 @@
+#include "dicom/dicom_utils.h"
+#include "dicom/trace.h"
+
+#include <QByteArrayView>
+
+#include <gdcmReader.h>
+#include <gdcmDataElement.h>
+#include <gdcmDataSet.h>
+#include <gdcmFileMetaInformation.h>
+#include <gdcmTransferSyntax.h>
+#include <gdcmStringFilter.h>
+#include <gdcmGlobal.h>
+#include <gdcmDicts.h>
+#include <gdcmDictEntry.h>
+#include <gdcmItem.h>
+#include <gdcmSequenceOfItems.h>
+#include <gdcmSmartPointer.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <set>
+
+namespace d3m {
+
+// One decimal value of a DS/IS string, surrounding padding removed
+static bool parseDecimal(const char* begin, const char* end, double& value) {
+    while (begin < end && (*begin == ' ' || *begin == '+')) ++begin;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\0')) --end;
+    if (begin == end) return false;
+#if defined(__cpp_lib_to_chars)
+    const auto [ptr, ec] = std::from_chars(begin, end, value);
+    return ec == std::errc() && ptr == end;
+#else
+    // no floating point from_chars in this standard library; still locale independent
+    bool ok = false;
+    value = QByteArrayView(begin, end - begin).toDouble(&ok);
+    return ok;
+#endif
+}
+
+template <typename T>
+static int readBinary(const char* bytes, std::size_t length, double* out, int count) {
+    const int n = std::min(count, static_cast<int>(length / sizeof(T)));
+    for (int i = 0; i < n; ++i) {
+        T v;
+        std::memcpy(&v, bytes + i * sizeof(T), sizeof(T));
+        out[i] = static_cast<double>(v);
+    }
+    return n;
+}
+
+int readNumbers(const gdcm::DataSet& ds, Tag t, double* out, int count) {
+    const gdcm::Tag tag(t.group, t.element);
+    const gdcm::DataElement& de = ds.GetDataElement(tag);
+    if (de.IsEmpty()) return 0;
+    const gdcm::ByteValue* bv = de.GetByteValue();
+    if (!bv) return 0;
+    const char* bytes = bv->GetPointer();
+    const std::size_t length = bv->GetLength();
+
+    gdcm::VR vr = de.GetVR();
+    if (vr == gdcm::VR::INVALID || vr == gdcm::VR::UN)
+        vr = gdcm::Global::GetInstance().GetDicts().GetDictEntry(tag).GetVR();
+
+    switch (vr) {
+    case gdcm::VR::US: return readBinary<uint16_t>(bytes, length, out, count);
+    case gdcm::VR::SS: return readBinary<int16_t>(bytes, length, out, count);
+    case gdcm::VR::UL: return readBinary<uint32_t>(bytes, length, out, count);
+    case gdcm::VR::SL: return readBinary<int32_t>(bytes, length, out, count);
+    case gdcm::VR::FL: return readBinary<float>(bytes, length, out, count);
+    case gdcm::VR::FD: return readBinary<double>(bytes, length, out, count);
+    default: break;
+    }
+
+    // DS/IS: backslash separated decimal strings
+    int parsed = 0;
+    const char* begin = bytes;
+    const char* end = bytes + length;
+    for (int index = 0; index < count; ++index) {
+        const char* sep = std::find(begin, end, '\\');
+        double v = 0.0;
+        if (parseDecimal(begin, sep, v)) {
+            out[index] = v;
+            ++parsed;
+        }
+        if (sep == end) break;
+        begin = sep + 1;
+    }
+    return parsed;
+}
+
+double getNumericTag(const gdcm::File& /*f*/,
+                     const gdcm::DataSet& ds,
+                     uint16_t group,
+                     uint16_t element,
+                     int index) {
+    constexpr int MaxValues = 16;
+    if (index < 0 || index >= MaxValues) return 0.0;
+    double values[MaxValues] = {};
+    readNumbers(ds, {group, element}, values, index + 1);
+    return values[index];
+}
+
+static QString getStringTag(const gdcm::File& f, const gdcm::DataSet& ds, const Tag& t) {
+    gdcm::Tag tag(t.group, t.element);
+    if (!ds.FindDataElement(tag)) return QString();
+
+    gdcm::StringFilter sf;
+    sf.SetFile(f);
+    return QString::fromStdString(sf.ToString(ds.GetDataElement(tag)));
+}
+
+// Calls f with the nested data set of every item of a sequence element
+template <typename F>
+static void forEachItem(const gdcm::DataSet& ds, Tag seq, F&& f) {
+    const gdcm::DataElement& de = ds.GetDataElement(gdcm::Tag(seq.group, seq.element));
+    if (de.IsEmpty()) return;
+    gdcm::SmartPointer<gdcm::SequenceOfItems> items = de.GetValueAsSQ();
+    if (!items) return;
+    for (gdcm::SequenceOfItems::SizeType i = 1; i <= items->GetNumberOfItems(); ++i)
+        f(items->GetItem(i).GetNestedDataSet());
+}
+
+// Overrides the geometry/rescale of a frame with what one functional group holds
+static void applyFunctionalGroup(const gdcm::DataSet& group, SliceInfo& s) {
+    forEachItem(group, PlanePositionSequence, [&](const gdcm::DataSet& item) {
+        double p[3];
+        if (readNumbers(item, ImagePositionPatient, p, 3) != 3) return;
+        s.imagePosX = p[0];
+        s.imagePosY = p[1];
+        s.imagePosZ = p[2];
+    });
+    forEachItem(group, PlaneOrientationSequence, [&](const gdcm::DataSet& item) {
+        double o[6];
+        if (readNumbers(item, ImageOrientationPatient, o, 6) != 6) return;
+        s.rowCosX = o[0]; s.rowCosY = o[1]; s.rowCosZ = o[2];
+        s.colCosX = o[3]; s.colCosY = o[4]; s.colCosZ = o[5];
+    });
+    forEachItem(group, PixelMeasuresSequence, [&](const gdcm::DataSet& item) {
+        double spacing[2];
+        if (readNumbers(item, PixelSpacing, spacing, 2) == 2) {
+            s.pixelSpacingX = spacing[0];
+            s.pixelSpacingY = spacing[1];
+        }
+        readNumbers(item, SliceThickness, &s.sliceThickness, 1);
+    });
+    forEachItem(group, PixelValueTransformSequence, [&](const gdcm::DataSet& item) {
+        readNumbers(item, RescaleSlope, &s.rescaleSlope, 1);
+        readNumbers(item, RescaleIntercept, &s.rescaleIntercept, 1);
+        if (s.rescaleSlope == 0.0) s.rescaleSlope = 1.0;
+    });
+    forEachItem(group, FrameVoiLutSequence, [&](const gdcm::DataSet& item) {
+        double center = 0.0, width = 0.0;
+        if (readNumbers(item, WindowCenter, &center, 1) == 1 && readNumbers(item, WindowWidth, &width, 1) == 1 &&
+            width >= 1.0) {
+            s.windowCenter = static_cast<int>(std::lround(center));
+            s.windowWidth = static_cast<int>(std::lround(width));
+        }
+    });
+}
+
+std::optional<SliceInfo> scanSlice(const QString& filePath) {
+    std::vector<SliceInfo> frames = scanFile(filePath);
+    if (frames.empty()) return std::nullopt;
+    return std::move(frames.front());
+}
+
+std::vector<SliceInfo> scanFile(const QString& filePath) {
+    D3M_TRACE_SCOPE("scanSlice");
+    gdcm::Reader r;
+    r.SetFileName(filePath.toStdString().c_str());
+    if (!r.ReadUpToTag(gdcm::Tag(PixelData.group, PixelData.element), std::set<gdcm::Tag>()))
+        return {};
+
+    const gdcm::File& file = r.GetFile();
+    const gdcm::DataSet& ds = file.GetDataSet();
+
+    SliceInfo slice;
+    slice.filePath       = filePath;
+    // every element is parsed once, straight from its bytes
+    const auto spacing     = readTag<PixelSpacing, double, 2>(ds);
+    const auto position    = readTag<ImagePositionPatient, double, 3>(ds);
+    const auto orientation = readTag<ImageOrientationPatient, double, 6>(ds);
+
+    slice.instanceNumber = readTag<InstanceNumber, int>(ds)[0];
+    slice.rows           = readTag<Rows, int>(ds)[0];
+    slice.columns        = readTag<Columns, int>(ds)[0];
+    slice.pixelSpacingX  = spacing[0];
+    slice.pixelSpacingY  = spacing[1];
+    slice.sliceThickness = readTag<SliceThickness>(ds)[0];
+    slice.imagePosX      = position[0];
+    slice.imagePosY      = position[1];
+    slice.imagePosZ      = position[2];
+    slice.rowCosX        = orientation[0];
+    slice.rowCosY        = orientation[1];
+    slice.rowCosZ        = orientation[2];
+    slice.colCosX        = orientation[3];
+    slice.colCosY        = orientation[4];
+    slice.colCosZ        = orientation[5];
+
+    slice.sliceLocation = slice.imagePosZ; // fallback if instanceNumber missing
+    slice.echoNumber       = readTag<EchoNumbers, int>(ds)[0];
+    slice.temporalPosition = readTag<TemporalPositionIdentifier, int>(ds)[0];
+    slice.triggerTime      = readTag<TriggerTime>(ds)[0];
+
+    slice.bitsAllocated       = readTag<BitsAllocated, int>(ds)[0];
+    slice.bitsStored          = readTag<BitsStored, int>(ds)[0];
+    if (slice.bitsStored <= 0 || slice.bitsStored > slice.bitsAllocated) slice.bitsStored = slice.bitsAllocated;
+    slice.pixelRepresentation = readTag<PixelRepresentation, int>(ds)[0];
+    slice.rescaleSlope        = readTag<RescaleSlope>(ds, 1.0)[0];
+    slice.rescaleIntercept    = readTag<RescaleIntercept>(ds, 0.0)[0];
+    if (slice.rescaleSlope == 0.0) slice.rescaleSlope = 1.0;
+    const double windowCenter = readTag<WindowCenter>(ds, -1.0)[0];
+    const double windowWidth  = readTag<WindowWidth>(ds, -1.0)[0];
+    if (windowWidth >= 1.0) {
+        slice.windowCenter = static_cast<int>(std::lround(windowCenter));
+        slice.windowWidth  = static_cast<int>(std::lround(windowWidth));
+    }
+
+    const char* ts = file.GetHeader().GetDataSetTransferSyntax().GetString();
+    if (ts) slice.transferSyntaxUID = QString::fromLatin1(ts);
+
+    slice.seriesUID  = getStringTag(file, ds, SeriesInstanceUID);
+    slice.seriesDesc = getStringTag(file, ds, SeriesDesc); // optional
+
+    slice.tags = collectTags(file);
+
+    std::vector<SliceInfo> frames;
+    slice.numberOfFrames = std::max(1, readTag<NumberOfFrames, int>(ds, 1)[0]);
+    if (slice.numberOfFrames == 1) {
+        frames.push_back(std::move(slice));
+        return frames;
+    }
+
+    // shared groups apply to every frame, per-frame groups override them
+    forEachItem(ds, SharedFunctionalGroups, [&](const gdcm::DataSet& group) {
+        applyFunctionalGroup(group, slice);
+    });
+    frames.assign(slice.numberOfFrames, slice);
+    int frame = 0;
+    forEachItem(ds, PerFrameFunctionalGroups, [&](const gdcm::DataSet& group) {
+        if (frame < slice.numberOfFrames) applyFunctionalGroup(group, frames[frame++]);
+    });
+    for (int i = 0; i < slice.numberOfFrames; ++i) {
+        frames[i].frameIndex = i;
+        frames[i].sliceLocation = frames[i].imagePosZ;
+    }
+    return frames;
+}
+
+} // namespace d3m
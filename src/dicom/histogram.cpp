@@ -0,0 +1,104 @@
+#include "dicom/histogram.h"
+#include "dicom/trace.h"
+#include "dicom/volume.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace d3m {
+
+void ValueHistogram::reset(bool isSigned) {
+    std::lock_guard lock(m_mutex);
+    m_signed = isSigned;
+    m_counts.assign(Size, 0);
+    m_total = 0;
+    m_slices = 0;
+}
+
+// Counted into a per-thread table first, so the lock is only held for the
+// merge. Only the span of values the slice holds is merged and cleared
+// again, which for a small slice is far less than the whole table.
+void ValueHistogram::addSlice(const uint16_t* data, std::size_t n) {
+    D3M_TRACE_SCOPE("histogram");
+    if (n == 0) return;
+    thread_local std::vector<uint32_t> local(Size, 0); // all zero between calls
+    // flipping the sign bit orders signed values from lowest to highest
+    const uint16_t flip = m_signed ? 0x8000 : 0;
+    uint16_t lo = 0xFFFF, hi = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto v = static_cast<uint16_t>(data[i] ^ flip);
+        ++local[v];
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_counts.size() != Size) m_counts.assign(Size, 0);
+        for (std::size_t i = lo; i <= hi; ++i)
+            m_counts[i] += local[i];
+        m_total += n;
+        ++m_slices;
+    }
+    std::fill(local.begin() + lo, local.begin() + hi + 1, 0u);
+}
+
+uint64_t ValueHistogram::total() const {
+    std::lock_guard lock(m_mutex);
+    return m_total;
+}
+
+int ValueHistogram::slices() const {
+    std::lock_guard lock(m_mutex);
+    return m_slices;
+}
+
+int ValueHistogram::percentile(double fraction) const {
+    std::lock_guard lock(m_mutex);
+    if (m_total == 0) return 0;
+    const auto target = static_cast<uint64_t>(std::clamp(fraction, 0.0, 1.0) * (m_total - 1));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < m_counts.size(); ++i) {
+        seen += m_counts[i];
+        if (seen > target) return valueAt(i);
+    }
+    return valueAt(Size - 1);
+}
+
+bool ValueHistogram::range(int& lo, int& hi) const {
+    std::lock_guard lock(m_mutex);
+    if (m_total == 0) return false;
+    std::size_t first = 0, last = m_counts.size() - 1;
+    while (m_counts[first] == 0) ++first;
+    while (m_counts[last] == 0) --last;
+    lo = valueAt(first);
+    hi = valueAt(last);
+    return true;
+}
+
+std::vector<int64_t> ValueHistogram::binned(int bins, int lo, int hi) const {
+    std::vector<int64_t> out(std::max(bins, 1), 0);
+    if (hi < lo) return out;
+    const double scale = static_cast<double>(out.size()) / (hi - lo + 1);
+    std::lock_guard lock(m_mutex);
+    if (m_counts.size() != Size) return out;
+    const int offset = m_signed ? 32768 : 0;
+    for (int v = lo; v <= hi; ++v)
+        out[std::min(static_cast<std::size_t>((v - lo) * scale), out.size() - 1)] += m_counts[v + offset];
+    return out;
+}
+
+bool autoWindow(const Volume& volume, int& center, int& width, double low, double high) {
+    const ValueHistogram& h = volume.histogram();
+    if (h.total() == 0) return false;
+    const double slope = volume.rescaleSlope();
+    const double intercept = volume.rescaleIntercept();
+    const double a = h.percentile(low) * slope + intercept;
+    const double b = h.percentile(high) * slope + intercept;
+    const double lo = std::min(a, b), hi = std::max(a, b);
+    width = std::max(1, static_cast<int>(std::lround(hi - lo)));
+    center = static_cast<int>(std::lround((lo + hi) / 2.0));
+    return true;
+}
+
+} // namespace d3m
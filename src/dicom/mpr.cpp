@@ -0,0 +1,116 @@
+#include "dicom/mpr.h"
+#include "dicom/parallel.h"
+#include "dicom/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace d3m {
+
+int planeWidth(const Volume& volume, Plane plane) {
+    return plane == Plane::Sagittal ? volume.height() : volume.width();
+}
+
+int planeHeight(const Volume& volume, Plane plane) {
+    return plane == Plane::Axial ? volume.height() : volume.depth();
+}
+
+int planeCount(const Volume& volume, Plane plane) {
+    switch (plane) {
+    case Plane::Axial:    return volume.depth();
+    case Plane::Coronal:  return volume.height();
+    case Plane::Sagittal: return volume.width();
+    }
+    return 0;
+}
+
+int planeIndex(Plane plane, const Voxel& voxel) {
+    switch (plane) {
+    case Plane::Axial:    return voxel.z;
+    case Plane::Coronal:  return voxel.y;
+    case Plane::Sagittal: return voxel.x;
+    }
+    return 0;
+}
+
+double planeAspect(const Volume& volume, Plane plane) {
+    switch (plane) {
+    case Plane::Axial:    return volume.spacingY() / volume.spacingX();
+    case Plane::Coronal:  return volume.spacingZ() / volume.spacingX();
+    case Plane::Sagittal: return volume.spacingZ() / volume.spacingY();
+    }
+    return 1.0;
+}
+
+QString planeName(const Volume& volume, Plane plane) {
+    // coronal planes lie along the rows, so their normal is the column direction
+    const Vec3& n = plane == Plane::Axial ? volume.normal()
+                  : plane == Plane::Coronal ? volume.colCosines() : volume.rowCosines();
+    int axis = 0;
+    for (int i = 1; i < 3; ++i)
+        if (std::abs(n[i]) > std::abs(n[axis])) axis = i;
+    // within ~35 degrees of the axis; x runs left, y posterior, z superior
+    if (std::abs(n[axis]) < 0.8) return QStringLiteral("Oblique");
+    static const char* const names[] = {"Sagittal", "Coronal", "Axial"};
+    return QString::fromLatin1(names[axis]);
+}
+
+void voxelToPlane(const Volume& volume, Plane plane, const Voxel& voxel, int& u, int& v) {
+    switch (plane) {
+    case Plane::Axial:    u = voxel.x; v = volume.height() - 1 - voxel.y; break;
+    case Plane::Coronal:  u = voxel.x; v = volume.depth() - 1 - voxel.z; break;
+    case Plane::Sagittal: u = voxel.y; v = volume.depth() - 1 - voxel.z; break;
+    }
+}
+
+void planeToVoxel(const Volume& volume, Plane plane, int u, int v, Voxel& voxel) {
+    u = std::clamp(u, 0, planeWidth(volume, plane) - 1);
+    v = std::clamp(v, 0, planeHeight(volume, plane) - 1);
+    switch (plane) {
+    case Plane::Axial:    voxel.x = u; voxel.y = volume.height() - 1 - v; break;
+    case Plane::Coronal:  voxel.x = u; voxel.z = volume.depth() - 1 - v; break;
+    case Plane::Sagittal: voxel.y = u; voxel.z = volume.depth() - 1 - v; break;
+    }
+}
+
+QImage renderPlane(const Volume& volume, Plane plane, int index, const WindowLut& lut) {
+    const int w = planeWidth(volume, plane);
+    const int h = planeHeight(volume, plane);
+    QImage img(w, h, QImage::Format_Grayscale8);
+    if (w == 0 || h == 0) return img;
+    index = std::clamp(index, 0, planeCount(volume, plane) - 1);
+
+    if (plane == Plane::Axial)
+        return renderSlice(volume, index, lut);
+
+    D3M_TRACE_SCOPE("mpr.plane");
+
+    const uint8_t* table = lut.table();
+    const int vw = volume.width();
+    const int d = volume.depth();
+
+    // one output row per slice z, top row = last slice
+    parallelFor(0, h, [&](int rowBegin, int rowEnd) {
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            const int z = d - 1 - row;
+            uchar* dst = img.scanLine(row);
+            const Volume::SliceRef pixels = volume.sliceRef(z);
+            if (!pixels) {
+                std::memset(dst, 0, w);
+                continue;
+            }
+            const uint16_t* slab = pixels.get();
+            if (plane == Plane::Coronal) {
+                lut.apply(slab + static_cast<std::size_t>(index) * vw, dst, w);
+            } else {
+                const uint16_t* col = slab + index;
+                for (int y = 0; y < w; ++y)
+                    dst[y] = table[col[static_cast<std::size_t>(y) * vw]];
+            }
+        }
+    });
+    return img;
+}
+
+} // namespace d3m
@@ -0,0 +1,92 @@
+#include "dicom/parallel.h"
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace d3m {
+
+namespace {
+
+struct Chunks {
+    std::atomic<int> next;
+    int end;
+    int grain;
+    const std::function<void(int, int)>& body;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    int pending = 0; // helpers not finished yet
+
+    void work() {
+        for (;;) {
+            const int b = next.fetch_add(grain);
+            if (b >= end) break;
+            body(b, std::min(b + grain, end));
+        }
+    }
+
+    void helperDone() {
+        {
+            std::lock_guard lock(mutex);
+            --pending;
+        }
+        cv.notify_all();
+    }
+};
+
+class Helper : public QRunnable {
+public:
+    explicit Helper(Chunks& chunks) : m_chunks(chunks) { setAutoDelete(false); }
+    void run() override {
+        m_chunks.work();
+        m_chunks.helperDone();
+    }
+
+private:
+    Chunks& m_chunks;
+};
+
+} // namespace
+
+void parallelFor(int begin, int end, const std::function<void(int, int)>& body, int grain) {
+    if (end <= begin) return;
+
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const int threads = std::max(1, pool->maxThreadCount());
+    const int count = end - begin;
+    if (grain <= 0) grain = std::max(1, count / (threads * 4));
+
+    const int chunks = (count + grain - 1) / grain;
+    const int helpers = std::min(threads, chunks) - 1;
+    if (helpers <= 0) {
+        body(begin, end);
+        return;
+    }
+
+    Chunks shared{{begin}, end, grain, body, {}, {}, helpers};
+    std::vector<std::unique_ptr<Helper>> tasks;
+    tasks.reserve(helpers);
+    for (int i = 0; i < helpers; ++i) {
+        tasks.push_back(std::make_unique<Helper>(shared));
+        pool->start(tasks.back().get());
+    }
+
+    shared.work();
+
+    // helpers still queued have nothing left to do
+    for (auto& task : tasks) {
+        if (pool->tryTake(task.get()))
+            shared.helperDone();
+    }
+    std::unique_lock lock(shared.mutex);
+    shared.cv.wait(lock, [&] { return shared.pending == 0; });
+}
+
+} // namespace d3m
@@ -0,0 +1,163 @@
+#include "dicom/projection.h"
+#include "dicom/parallel.h"
+#include "dicom/trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace d3m {
+
+namespace {
+
+// The reductions run across a whole row of rays at a time (or along one
+// contiguous ray for sagittal slabs), with the mode switch hoisted out of the
+// loops so each loop is a plain elementwise min/max/add the compiler vectorizes.
+template <typename T>
+void reduceRows(ProjectionMode mode, const T* src, T* dst, int32_t* sum, int n) {
+    switch (mode) {
+    case ProjectionMode::Mip:
+        for (int i = 0; i < n; ++i) dst[i] = std::max(dst[i], src[i]);
+        break;
+    case ProjectionMode::MinIp:
+        for (int i = 0; i < n; ++i) dst[i] = std::min(dst[i], src[i]);
+        break;
+    case ProjectionMode::Average:
+        for (int i = 0; i < n; ++i) sum[i] += src[i];
+        break;
+    }
+}
+
+template <typename T>
+T reduceRun(ProjectionMode mode, const T* run, int n) {
+    switch (mode) {
+    case ProjectionMode::Mip: {
+        T m = run[0];
+        for (int i = 1; i < n; ++i) m = std::max(m, run[i]);
+        return m;
+    }
+    case ProjectionMode::MinIp: {
+        T m = run[0];
+        for (int i = 1; i < n; ++i) m = std::min(m, run[i]);
+        return m;
+    }
+    case ProjectionMode::Average: {
+        int32_t s = 0;
+        for (int i = 0; i < n; ++i) s += run[i];
+        return static_cast<T>(s / n);
+    }
+    }
+    return T{};
+}
+
+template <typename T>
+void finishAverage(const int32_t* sum, T* dst, int n, int count) {
+    for (int i = 0; i < n; ++i) dst[i] = static_cast<T>(sum[i] / count);
+}
+
+// Rows of the output are independent, so they are spread over the pool.
+// T is the stored type; the slab and the output hold its bit pattern.
+template <typename T>
+void project(const Volume& volume, Plane plane, int first, int last, ProjectionMode mode, uint16_t* out) {
+    const int w = volume.width();
+    const int h = volume.height();
+    const int d = volume.depth();
+    const int outWidth = planeWidth(volume, plane);
+    const int outHeight = planeHeight(volume, plane);
+    // held for the whole projection, so no slice is evicted halfway through
+    std::vector<Volume::SliceRef> slices(d);
+    for (int z = 0; z < d; ++z) {
+        if (plane != Plane::Axial || (z >= first && z < last)) slices[z] = volume.sliceRef(z);
+    }
+    auto voxels = [&](int z) { return reinterpret_cast<const T*>(slices[z].get()); };
+
+    parallelFor(0, outHeight, [&](int rowBegin, int rowEnd) {
+        std::vector<int32_t> sum(mode == ProjectionMode::Average ? outWidth : 0);
+        for (int row = rowBegin; row < rowEnd; ++row) {
+            T* dst = reinterpret_cast<T*>(out + static_cast<std::size_t>(row) * outWidth);
+            std::fill(sum.begin(), sum.end(), 0);
+
+            if (plane == Plane::Axial) {
+                // march along z; the row of rays is contiguous in every slice
+                const std::size_t offset = static_cast<std::size_t>(h - 1 - row) * w;
+                int count = 0;
+                for (int z = first; z < last; ++z) {
+                    if (!slices[z]) continue;
+                    if (count++ == 0 && mode != ProjectionMode::Average)
+                        std::memcpy(dst, voxels(z) + offset, w * sizeof(T));
+                    else
+                        reduceRows(mode, voxels(z) + offset, dst, sum.data(), w);
+                }
+                if (count == 0) std::fill(dst, dst + w, T{});
+                else if (mode == ProjectionMode::Average) finishAverage(sum.data(), dst, w, count);
+                continue;
+            }
+
+            const int z = d - 1 - row;
+            if (!slices[z]) {
+                std::fill(dst, dst + outWidth, T{});
+                continue;
+            }
+            const T* slab = voxels(z);
+            if (plane == Plane::Coronal) {
+                // march along y; each step is a whole image row
+                const int count = last - first;
+                if (mode != ProjectionMode::Average)
+                    std::memcpy(dst, slab + static_cast<std::size_t>(first) * w, w * sizeof(T));
+                for (int y = first + (mode != ProjectionMode::Average ? 1 : 0); y < last; ++y)
+                    reduceRows(mode, slab + static_cast<std::size_t>(y) * w, dst, sum.data(), w);
+                if (mode == ProjectionMode::Average) finishAverage(sum.data(), dst, w, count);
+            } else {
+                // sagittal: each ray is a contiguous run of one image row
+                for (int y = 0; y < h; ++y)
+                    dst[y] = reduceRun(mode, slab + static_cast<std::size_t>(y) * w + first, last - first);
+            }
+        }
+    });
+}
+
+} // namespace
+
+void slabRange(const Volume& volume, Plane plane, int center, int thickness, int& first, int& last) {
+    const int count = planeCount(volume, plane);
+    thickness = std::max(thickness, 1);
+    first = std::clamp(center - (thickness - 1) / 2, 0, std::max(count - 1, 0));
+    last = std::clamp(first + thickness, first, count);
+}
+
+std::vector<uint16_t> projectSlab(const Volume& volume, Plane plane, int first, int last, ProjectionMode mode) {
+    D3M_TRACE_SCOPE("projection");
+    std::vector<uint16_t> out(static_cast<std::size_t>(planeWidth(volume, plane)) * planeHeight(volume, plane), 0);
+    if (out.empty() || first >= last) return out;
+
+    if (volume.pixelType() == PixelType::Int16)
+        project<int16_t>(volume, plane, first, last, mode, out.data());
+    else
+        project<uint16_t>(volume, plane, first, last, mode, out.data());
+    return out;
+}
+
+QImage renderProjection(const Volume& volume, Plane plane, int center, int thickness,
+                        ProjectionMode mode, const WindowLut& lut) {
+    const int w = planeWidth(volume, plane);
+    const int h = planeHeight(volume, plane);
+    QImage img(w, h, QImage::Format_Grayscale8);
+    if (w == 0 || h == 0) return img;
+
+    int first = 0, last = 0;
+    slabRange(volume, plane, center, thickness, first, last);
+    const std::vector<uint16_t> values = projectSlab(volume, plane, first, last, mode);
+
+    bool anyLoaded = plane != Plane::Axial;
+    for (int z = first; z < last && !anyLoaded; ++z)
+        anyLoaded = volume.isSliceLoaded(z);
+
+    for (int row = 0; row < h; ++row) {
+        uchar* dst = img.scanLine(row);
+        const bool hasData = plane == Plane::Axial ? anyLoaded : volume.isSliceLoaded(volume.depth() - 1 - row);
+        if (hasData) lut.apply(values.data() + static_cast<std::size_t>(row) * w, dst, w);
+        else std::memset(dst, 0, w);
+    }
+    return img;
+}
+
+} // namespace d3m
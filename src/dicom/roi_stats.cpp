@@ -0,0 +1,132 @@
+#include "dicom/roi_stats.h"
+#include "dicom/parallel.h"
+#include "dicom/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+namespace d3m {
+
+namespace {
+
+struct Moments {
+    int64_t count = 0;
+    int64_t sum = 0;
+    int64_t sumSq = 0;
+    int min = std::numeric_limits<int>::max();
+    int max = std::numeric_limits<int>::min();
+
+    void merge(const Moments& o) {
+        count += o.count;
+        sum += o.sum;
+        sumSq += o.sumSq;
+        min = std::min(min, o.min);
+        max = std::max(max, o.max);
+    }
+};
+
+// One row of the box: plain elementwise sums and min/max, which the compiler
+// vectorizes. T is the stored type.
+template <typename T>
+void accumulateRow(const T* p, int n, Moments& m) {
+    int64_t sum = 0, sumSq = 0;
+    int lo = m.min, hi = m.max;
+    for (int i = 0; i < n; ++i) {
+        const int v = p[i];
+        sum += v;
+        sumSq += static_cast<int64_t>(v) * v;
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+    }
+    m.count += n;
+    m.sum += sum;
+    m.sumSq += sumSq;
+    m.min = lo;
+    m.max = hi;
+}
+
+template <typename T>
+void histogramRow(const T* p, int n, int lo, double scale, int64_t* bins, int last) {
+    for (int i = 0; i < n; ++i)
+        ++bins[std::min(static_cast<int>((p[i] - lo) * scale), last)];
+}
+
+// The box rows of all loaded slices, flattened so the pool splits them evenly
+template <typename T>
+RoiStats measure(const Volume& volume, const RoiBox& box, int bins) {
+    std::vector<Volume::SliceRef> slices;
+    for (int z = box.z0; z < box.z1; ++z) {
+        if (Volume::SliceRef pixels = volume.sliceRef(z)) slices.push_back(std::move(pixels));
+    }
+    const int rows = box.y1 - box.y0;
+    const int n = box.x1 - box.x0;
+    const int total = static_cast<int>(slices.size()) * rows;
+    auto row = [&](int i) {
+        const T* p = reinterpret_cast<const T*>(slices[i / rows].get());
+        return p + static_cast<std::size_t>(box.y0 + i % rows) * volume.width() + box.x0;
+    };
+
+    Moments m;
+    std::mutex mutex;
+    parallelFor(0, total, [&](int b, int e) {
+        Moments local;
+        for (int i = b; i < e; ++i) accumulateRow(row(i), n, local);
+        std::lock_guard lock(mutex);
+        m.merge(local);
+    });
+
+    RoiStats s;
+    s.slices = static_cast<int>(slices.size());
+    s.count = m.count;
+    if (m.count == 0) return s;
+
+    // stored -> modality units; a negative slope swaps the extremes
+    const double slope = volume.rescaleSlope();
+    const double intercept = volume.rescaleIntercept();
+    const double mean = static_cast<double>(m.sum) / m.count;
+    const double variance = std::max(0.0, static_cast<double>(m.sumSq) / m.count - mean * mean);
+    s.mean = mean * slope + intercept;
+    s.sd = std::sqrt(variance) * std::abs(slope);
+    s.min = std::min(m.min * slope, m.max * slope) + intercept;
+    s.max = std::max(m.min * slope, m.max * slope) + intercept;
+
+    // second pass once the range is known; integer stored values, so the
+    // bins are whole stored steps wide at most
+    bins = std::max(1, std::min(bins, m.max - m.min + 1));
+    const double scale = static_cast<double>(bins) / (m.max - m.min + 1);
+    s.histogram.assign(bins, 0);
+    s.binWidth = (s.max - s.min + std::abs(slope)) / bins;
+    parallelFor(0, total, [&](int b, int e) {
+        std::vector<int64_t> local(bins, 0);
+        for (int i = b; i < e; ++i) histogramRow(row(i), n, m.min, scale, local.data(), bins - 1);
+        std::lock_guard lock(mutex);
+        for (int i = 0; i < bins; ++i) s.histogram[i] += local[i];
+    });
+    // bins run from the lowest modality value up
+    if (slope < 0.0) std::reverse(s.histogram.begin(), s.histogram.end());
+    return s;
+}
+
+} // namespace
+
+RoiStats computeRoiStats(const Volume& volume, RoiBox box, int bins) {
+    D3M_TRACE_SCOPE("roi.stats");
+    box.x0 = std::clamp(box.x0, 0, volume.width());
+    box.x1 = std::clamp(box.x1, box.x0, volume.width());
+    box.y0 = std::clamp(box.y0, 0, volume.height());
+    box.y1 = std::clamp(box.y1, box.y0, volume.height());
+    box.z0 = std::clamp(box.z0, 0, volume.depth());
+    box.z1 = std::clamp(box.z1, box.z0, volume.depth());
+    if (box.x0 == box.x1 || box.y0 == box.y1 || box.z0 == box.z1) return {};
+
+    RoiStats s = volume.pixelType() == PixelType::Int16 ? measure<int16_t>(volume, box, bins)
+                                                        : measure<uint16_t>(volume, box, bins);
+    s.areaMm2 = (box.x1 - box.x0) * volume.spacingX() * (box.y1 - box.y0) * volume.spacingY();
+    s.volumeMm3 = s.areaMm2 * s.slices * volume.spacingZ();
+    return s;
+}
+
+} // namespace d3m
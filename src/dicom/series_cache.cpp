@@ -0,0 +1,167 @@
+#include "dicom/series_cache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace d3m {
+
+static constexpr quint32 IndexMagic = 0x44334D49; // "D3MI"
+static constexpr quint32 IndexVersion = 5;
+
+static void writeSlice(QDataStream& out, const SliceInfo& s) {
+    out << s.seriesUID << s.seriesDesc
+        << qint32(s.instanceNumber) << qint32(s.rows) << qint32(s.columns)
+        << s.pixelSpacingX << s.pixelSpacingY << s.sliceThickness
+        << s.imagePosX << s.imagePosY << s.imagePosZ << s.sliceLocation
+        << s.rowCosX << s.rowCosY << s.rowCosZ
+        << s.colCosX << s.colCosY << s.colCosZ
+        << qint32(s.bitsAllocated) << qint32(s.bitsStored) << qint32(s.pixelRepresentation)
+        << s.rescaleSlope << s.rescaleIntercept << s.transferSyntaxUID
+        << qint32(s.windowCenter) << qint32(s.windowWidth)
+        << qint32(s.frameIndex) << qint32(s.numberOfFrames)
+        << qint32(s.echoNumber) << qint32(s.temporalPosition) << s.triggerTime;
+
+    out << quint32(s.tags.size());
+    for (const TagEntry& e : s.tags)
+        out << quint32(e.tag) << e.value;
+}
+
+// Frames after the first of a multi-frame file only store what the
+// functional groups can change; header and tags are the first frame's
+static void writeFrame(QDataStream& out, const SliceInfo& s) {
+    out << qint32(s.frameIndex)
+        << s.pixelSpacingX << s.pixelSpacingY << s.sliceThickness
+        << s.imagePosX << s.imagePosY << s.imagePosZ << s.sliceLocation
+        << s.rowCosX << s.rowCosY << s.rowCosZ
+        << s.colCosX << s.colCosY << s.colCosZ
+        << s.rescaleSlope << s.rescaleIntercept;
+}
+
+static void readFrame(QDataStream& in, SliceInfo& s) {
+    qint32 frameIndex = 0;
+    in >> frameIndex
+       >> s.pixelSpacingX >> s.pixelSpacingY >> s.sliceThickness
+       >> s.imagePosX >> s.imagePosY >> s.imagePosZ >> s.sliceLocation
+       >> s.rowCosX >> s.rowCosY >> s.rowCosZ
+       >> s.colCosX >> s.colCosY >> s.colCosZ
+       >> s.rescaleSlope >> s.rescaleIntercept;
+    s.frameIndex = frameIndex;
+}
+
+static void readSlice(QDataStream& in, SliceInfo& s) {
+    qint32 instanceNumber = 0, rows = 0, columns = 0, bits = 0, stored = 0, repr = 0, wc = 0, ww = 0;
+    qint32 frameIndex = 0, frames = 1, echo = 0, temporal = 0;
+    in >> s.seriesUID >> s.seriesDesc
+       >> instanceNumber >> rows >> columns
+       >> s.pixelSpacingX >> s.pixelSpacingY >> s.sliceThickness
+       >> s.imagePosX >> s.imagePosY >> s.imagePosZ >> s.sliceLocation
+       >> s.rowCosX >> s.rowCosY >> s.rowCosZ
+       >> s.colCosX >> s.colCosY >> s.colCosZ
+       >> bits >> stored >> repr
+       >> s.rescaleSlope >> s.rescaleIntercept >> s.transferSyntaxUID
+       >> wc >> ww
+       >> frameIndex >> frames
+       >> echo >> temporal >> s.triggerTime;
+    s.instanceNumber = instanceNumber;
+    s.rows = rows;
+    s.columns = columns;
+    s.bitsAllocated = bits;
+    s.bitsStored = stored;
+    s.pixelRepresentation = repr;
+    s.windowCenter = wc;
+    s.windowWidth = ww;
+    s.frameIndex = frameIndex;
+    s.numberOfFrames = frames;
+    s.echoNumber = echo;
+    s.temporalPosition = temporal;
+
+    quint32 count = 0;
+    in >> count;
+    s.tags.clear();
+    s.tags.reserve(count);
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        TagEntry e;
+        quint32 tag = 0;
+        in >> tag >> e.value;
+        e.tag = tag;
+        s.tags.push_back(std::move(e));
+    }
+}
+
+SeriesCache::SeriesCache(const QString& folder) {
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/series-index";
+    const QByteArray key = QCryptographicHash::hash(QDir(folder).absolutePath().toUtf8(),
+                                                    QCryptographicHash::Sha1).toHex();
+    m_indexPath = dir + "/" + QString::fromLatin1(key) + ".d3mi";
+}
+
+bool SeriesCache::load() {
+    m_entries.clear();
+    QFile f(m_indexPath);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (magic != IndexMagic || version != IndexVersion) return false;
+
+    m_entries.reserve(count);
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Entry e;
+        quint32 frames = 0;
+        in >> e.filePath >> e.size >> e.mtime >> frames;
+        if (frames > 0) {
+            SliceInfo first;
+            first.filePath = e.filePath;
+            readSlice(in, first);
+            e.slices.reserve(frames);
+            e.slices.push_back(std::move(first));
+            for (quint32 f = 1; f < frames && in.status() == QDataStream::Ok; ++f) {
+                SliceInfo frame = e.slices.front();
+                readFrame(in, frame);
+                e.slices.push_back(std::move(frame));
+            }
+        }
+        m_entries.insert(e.filePath, std::move(e));
+    }
+
+    // a truncated file is not trusted at all
+    if (in.status() != QDataStream::Ok) {
+        m_entries.clear();
+        return false;
+    }
+    return true;
+}
+
+bool SeriesCache::save(const std::vector<Entry>& entries) const {
+    QDir().mkpath(QFileInfo(m_indexPath).absolutePath());
+    QSaveFile f(m_indexPath);
+    if (!f.open(QIODevice::WriteOnly)) return false;
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << IndexMagic << IndexVersion << quint32(entries.size());
+    for (const Entry& e : entries) {
+        out << e.filePath << e.size << e.mtime << quint32(e.slices.size());
+        if (e.slices.empty()) continue;
+        writeSlice(out, e.slices.front());
+        for (std::size_t f = 1; f < e.slices.size(); ++f)
+            writeFrame(out, e.slices[f]);
+    }
+    return f.commit();
+}
+
+const SeriesCache::Entry* SeriesCache::find(const QFileInfo& file) const {
+    auto it = m_entries.constFind(file.absoluteFilePath());
+    if (it == m_entries.constEnd()) return nullptr;
+    if (it->size != file.size() || it->mtime != file.lastModified().toMSecsSinceEpoch()) return nullptr;
+    return &it.value();
+}
+
+} // namespace d3m
@@ -0,0 +1,200 @@
+#include "dicom/series_loader.h"
+#include "dicom/trace.h"
+
+#include <QFileInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <iterator>
+
+namespace d3m {
+
+SeriesLoader::SeriesLoader(QObject* parent) : QObject(parent) {
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+SeriesLoader::~SeriesLoader() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+void SeriesLoader::start(const QStringList& files) {
+    // only one run at a time; the previous one stops after its current file
+    cancel();
+    m_pool.waitForDone();
+
+    // the index file is read by the first worker, not on the caller's thread
+    m_cache = std::make_unique<SeriesCache>(files.isEmpty() ? QString() : QFileInfo(files.front()).absolutePath());
+    m_cacheLoaded = std::make_unique<std::once_flag>();
+    {
+        std::lock_guard lock(m_mutex);
+        m_entries.clear();
+        m_sorter = {};
+    }
+    append(files);
+}
+
+bool SeriesLoader::append(const QStringList& files) {
+    if (isRunning()) return false;
+
+    m_files = files;
+    m_next = 0;
+    m_done = 0;
+    m_scanned = 0;
+    m_cancel = false;
+    m_clock.start();
+    m_lastBatch = -1;
+    {
+        std::lock_guard lock(m_mutex);
+        m_partials.clear();
+        m_result.reset();
+        m_index.reset();
+        m_replaced.clear();
+        const std::set<QString> wanted(files.begin(), files.end());
+        for (const SeriesCache::Entry& entry : m_entries) {
+            if (wanted.count(entry.filePath)) m_replaced.insert(entry.filePath);
+        }
+    }
+
+    const int workers = std::max(1, std::min<int>(m_pool.maxThreadCount(), m_files.size()));
+    m_activeWorkers = workers;
+    m_running = true;
+    for (int i = 0; i < workers; ++i)
+        m_pool.start([this] { runWorker(); });
+    return true;
+}
+
+void SeriesLoader::cancel() {
+    m_cancel = true;
+    // whatever the run found but the GUI has not taken yet is dropped, so
+    // its queued seriesFound()/finished() hand out nothing
+    std::lock_guard lock(m_mutex);
+    m_sorter.takeChanged();
+    m_result.reset();
+    m_index.reset();
+}
+
+bool SeriesLoader::isRunning() const {
+    return m_running.load();
+}
+
+std::optional<SeriesMap> SeriesLoader::takeResult() {
+    std::lock_guard lock(m_mutex);
+    std::optional<SeriesMap> result;
+    result.swap(m_result);
+    return result;
+}
+
+int SeriesLoader::scannedFiles() const {
+    return m_scanned.load();
+}
+
+StackUpdates SeriesLoader::takeUpdates() {
+    std::lock_guard lock(m_mutex);
+    return m_sorter.takeChanged();
+}
+
+std::unique_ptr<TagSearchIndex> SeriesLoader::takeSearchIndex() {
+    std::lock_guard lock(m_mutex);
+    return std::move(m_index);
+}
+
+void SeriesLoader::runWorker() {
+    std::call_once(*m_cacheLoaded, [this] { m_cache->load(); });
+
+    const int total = m_files.size();
+    // emit roughly once per percent, the GUI does not need more
+    const int step = std::max(1, total / 100);
+    std::vector<SeriesCache::Entry> local;
+
+    while (!m_cancel) {
+        const int i = m_next.fetch_add(1);
+        if (i >= total) break;
+
+        // unchanged files come from the on-disk index, the rest are parsed
+        const QFileInfo info(m_files[i]);
+        if (const SeriesCache::Entry* cached = m_cache->find(info)) {
+            local.push_back(*cached);
+        } else {
+            SeriesCache::Entry entry;
+            entry.filePath = m_files[i];
+            entry.size = info.size();
+            entry.mtime = info.lastModified().toMSecsSinceEpoch();
+            entry.slices = scanFile(m_files[i]);
+            local.push_back(std::move(entry));
+            ++m_scanned;
+        }
+
+        {
+            // sorted as it arrives; the entry itself is kept for the index file
+            std::lock_guard lock(m_mutex);
+            if (m_cancel) break;
+            if (m_replaced.count(m_files[i])) m_sorter.removeFile(m_files[i]);
+            for (const SliceInfo& slice : local.back().slices) {
+                if (!slice.seriesUID.isEmpty()) m_sorter.add(slice);
+            }
+        }
+
+        // one batch per interval, whichever worker gets there first
+        const qint64 now = m_clock.elapsed();
+        qint64 last = m_lastBatch.load();
+        if ((last < 0 || now - last >= BatchIntervalMs) && m_lastBatch.compare_exchange_strong(last, now))
+            emit seriesFound();
+
+        const int done = m_done.fetch_add(1) + 1;
+        if (done % step == 0 || done == total)
+            emit progress(done, total);
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_partials.push_back(std::move(local));
+    }
+
+    // last one out merges; the run only ends once that is done, so append()
+    // cannot reset it underneath the merge. The signals are queued to the GUI
+    // thread and go out after, there a new run already being under way marks
+    // them stale.
+    if (m_activeWorkers.fetch_sub(1) == 1) {
+        const bool merged = mergeResults();
+        m_running = false;
+        if (merged) emit finished();
+        else emit cancelled();
+    }
+}
+
+bool SeriesLoader::mergeResults() {
+    D3M_TRACE_SCOPE("series.merge");
+    std::lock_guard lock(m_mutex);
+    // checked under the lock: a cancel() after this drops the result instead
+    if (m_cancel) {
+        m_partials.clear();
+        return false;
+    }
+
+    // rescanned files replace what an earlier run found in them
+    std::erase_if(m_entries, [this](const SeriesCache::Entry& e) { return m_replaced.count(e.filePath) > 0; });
+    for (auto& part : m_partials)
+        std::move(part.begin(), part.end(), std::back_inserter(m_entries));
+    m_partials.clear();
+
+    // only rewrite the index if something was actually parsed
+    if (m_scanned > 0)
+        m_cache->save(m_entries);
+
+    // already split and in order; tag values are shared across each series
+    // in the sorter, so the copies handed out share them too. The sorter
+    // keeps its slices for files that are appended later.
+    m_sorter.internTags();
+    SeriesMap map = m_sorter.stacks();
+
+    auto index = std::make_unique<TagSearchIndex>();
+    for (const auto& kv : map)
+        index->addSeries(kv.first, kv.second);
+
+    m_result = std::move(map);
+    m_index = std::move(index);
+    return true;
+}
+
+} // namespace d3m
@@ -0,0 +1,349 @@
+#include "dicom/series_sorter.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+
+namespace d3m {
+
+namespace {
+
+using Vec3 = std::array<double, 3>;
+
+constexpr double OrientationTolerance = 1e-3;
+
+Vec3 sliceNormal(const SliceInfo& s) {
+    const Vec3 r = {s.rowCosX, s.rowCosY, s.rowCosZ};
+    const Vec3 c = {s.colCosX, s.colCosY, s.colCosZ};
+    const Vec3 n = {r[1]*c[2] - r[2]*c[1], r[2]*c[0] - r[0]*c[2], r[0]*c[1] - r[1]*c[0]};
+    // no orientation: axial, i.e. sorted by z like before
+    if (n[0] == 0.0 && n[1] == 0.0 && n[2] == 0.0) return {0.0, 0.0, 1.0};
+    return n;
+}
+
+double alongNormal(const SliceInfo& s, const Vec3& n) {
+    return s.imagePosX * n[0] + s.imagePosY * n[1] + s.imagePosZ * n[2];
+}
+
+int64_t micrometres(double mm) {
+    return std::llround(mm * 1000.0);
+}
+
+// Acquisition order wins over the normal's sign
+bool reversedByInstance(const SliceInfo& first, const SliceInfo& last) {
+    return first.instanceNumber > 0 && last.instanceNumber > 0 && first.instanceNumber > last.instanceNumber &&
+           (first.imagePosX != last.imagePosX || first.imagePosY != last.imagePosY || first.imagePosZ != last.imagePosZ);
+}
+
+void orientByInstance(std::vector<SliceInfo>& stack) {
+    if (stack.size() >= 2 && reversedByInstance(stack.front(), stack.back()))
+        std::reverse(stack.begin(), stack.end());
+}
+
+} // namespace
+
+void sortSeries(std::vector<SliceInfo>& stack) {
+    if (stack.empty()) return;
+    const Vec3 n = sliceNormal(stack.front());
+    std::vector<std::pair<int64_t, std::size_t>> keys(stack.size());
+    for (std::size_t i = 0; i < stack.size(); ++i)
+        keys[i] = {micrometres(alongNormal(stack[i], n)), i};
+
+    std::vector<std::size_t> order(stack.size());
+    for (std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        const SliceInfo& sa = stack[a];
+        const SliceInfo& sb = stack[b];
+        return std::tie(keys[a].first, sa.triggerTime, sa.instanceNumber, sa.frameIndex) <
+               std::tie(keys[b].first, sb.triggerTime, sb.instanceNumber, sb.frameIndex);
+    });
+
+    std::vector<SliceInfo> sorted;
+    sorted.reserve(stack.size());
+    for (std::size_t i : order) sorted.push_back(std::move(stack[i]));
+    stack = std::move(sorted);
+    orientByInstance(stack);
+}
+
+StackGeometry analyzeStack(const std::vector<SliceInfo>& stack) {
+    StackGeometry g;
+    if (stack.size() < 2) return g;
+
+    const Vec3 n = sliceNormal(stack.front());
+    std::vector<double> spacings;
+    spacings.reserve(stack.size() - 1);
+    for (std::size_t i = 1; i < stack.size(); ++i) {
+        const double d = std::abs(alongNormal(stack[i], n) - alongNormal(stack[i - 1], n));
+        if (micrometres(d) == 0) ++g.duplicates;
+        else spacings.push_back(d);
+    }
+    if (spacings.empty()) return g;
+
+    const auto [lo, hi] = std::minmax_element(spacings.begin(), spacings.end());
+    g.minSpacing = *lo;
+    g.maxSpacing = *hi;
+    std::vector<double> sorted = spacings;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    g.spacing = sorted[sorted.size() / 2];
+    if (g.spacing <= 0.0) return g; // no positions to go by
+
+    for (double d : spacings) {
+        if (d > 1.5 * g.spacing) ++g.gaps;
+        if (std::abs(d - g.spacing) > 0.1 * g.spacing) g.uniform = false;
+    }
+    return g;
+}
+
+void SeriesSorter::add(SliceInfo slice) {
+    Series& series = m_series[slice.seriesUID];
+
+    const Vec3 row = {slice.rowCosX, slice.rowCosY, slice.rowCosZ};
+    const Vec3 col = {slice.colCosX, slice.colCosY, slice.colCosZ};
+    const auto same = [&](const Orientation& o) {
+        for (int i = 0; i < 3; ++i) {
+            if (std::abs(o.row[i] - row[i]) > OrientationTolerance) return false;
+            if (std::abs(o.col[i] - col[i]) > OrientationTolerance) return false;
+        }
+        return true;
+    };
+    auto it = std::find_if(series.orientations.begin(), series.orientations.end(), same);
+    if (it == series.orientations.end())
+        it = series.orientations.insert(series.orientations.end(), {row, col, sliceNormal(slice)});
+    const int orientation = static_cast<int>(it - series.orientations.begin());
+
+    const Order order{micrometres(alongNormal(slice, it->normal)), slice.triggerTime,
+                      slice.instanceNumber, slice.frameIndex};
+    const GroupKey group{orientation, slice.echoNumber, slice.temporalPosition};
+    m_changed.insert(slice.seriesUID);
+    series.groups[group].emplace(order, Entry{std::move(slice)});
+    ++m_count;
+}
+
+void SeriesSorter::removeFile(const QString& filePath) {
+    for (auto& [uid, series] : m_series) {
+        for (auto& [group, slices] : series.groups) {
+            for (auto it = slices.begin(); it != slices.end();) {
+                if (it->second.slice.filePath != filePath) {
+                    ++it;
+                    continue;
+                }
+                if (it->second.handed >= 0) series.removed = true;
+                it = slices.erase(it);
+                m_changed.insert(uid);
+                --m_count;
+            }
+        }
+        std::erase_if(series.groups, [](const auto& kv) { return kv.second.empty(); });
+    }
+}
+
+SeriesMap SeriesSorter::take() {
+    SeriesMap result;
+    for (auto& [uid, series] : m_series) {
+        auto stacks = layout(uid, series);
+        handOut(series, stacks, false, result);
+    }
+    m_series.clear();
+    m_changed.clear();
+    m_count = 0;
+    return result;
+}
+
+SeriesMap SeriesSorter::stacks() {
+    SeriesMap result;
+    for (auto& [uid, series] : m_series) {
+        auto stacks = layout(uid, series);
+        handOut(series, stacks, true, result);
+    }
+    m_changed.clear();
+    return result;
+}
+
+// Walks each changed series' order (pointers only) and copies out just the
+// slices it has not handed out yet, with their index in the grown stack.
+// Slices that moved to another stack, a stack that flipped direction or
+// lost slices get the series handed out whole.
+StackUpdates SeriesSorter::takeChanged() {
+    StackUpdates result;
+    for (const QString& uid : m_changed) {
+        Series& series = m_series[uid];
+        auto stacks = layout(uid, series);
+
+        bool reset = series.removed || stacks.size() != series.handedKeys.size();
+        for (std::size_t i = 0; i < stacks.size() && !reset; ++i) {
+            reset = stacks[i].key != series.handedKeys[i] || stacks[i].reversed != series.handedReversed[i] ||
+                    std::any_of(stacks[i].entries.begin(), stacks[i].entries.end(), [i](const Entry* e) {
+                        return e->handed >= 0 && e->handed != static_cast<int>(i);
+                    });
+        }
+        if (reset) {
+            // stacks the series no longer has go out empty
+            for (const QString& key : series.handedKeys) result[key].reset = true;
+            SeriesMap whole;
+            handOut(series, stacks, true, whole);
+            for (auto& [key, slices] : whole) {
+                StackUpdate& update = result[key];
+                update.reset = true;
+                update.slices = std::move(slices);
+            }
+            continue;
+        }
+
+        for (std::size_t i = 0; i < stacks.size(); ++i) {
+            StackUpdate update;
+            const auto& entries = stacks[i].entries;
+            for (std::size_t z = 0; z < entries.size(); ++z) {
+                if (entries[z]->handed >= 0) continue;
+                entries[z]->handed = static_cast<int>(i);
+                update.positions.push_back(static_cast<int>(z));
+                update.slices.push_back(entries[z]->slice);
+                update.slices.back().seriesDesc += stacks[i].suffix;
+            }
+            if (!update.slices.empty()) result[stacks[i].key] = std::move(update);
+        }
+    }
+    m_changed.clear();
+    return result;
+}
+
+void SeriesSorter::internTags() {
+    for (auto& [uid, series] : m_series) {
+        std::vector<TagStore*> stores;
+        for (auto& [group, slices] : series.groups) {
+            for (auto& kv : slices) stores.push_back(&kv.second.slice.tags);
+        }
+        d3m::internTags(stores);
+    }
+}
+
+// Splits one series into its stacks, in display order
+std::vector<SeriesSorter::Stack> SeriesSorter::layout(const QString& uid, Series& series) {
+    struct Part {
+        GroupKey group;
+        int phase;
+        std::vector<Entry*> entries;
+    };
+    std::vector<Part> parts;
+    std::set<int> echoes, temporals;
+    bool phased = false;
+
+    for (auto& [group, slices] : series.groups) {
+        echoes.insert(std::get<1>(group));
+        temporals.insert(std::get<2>(group));
+
+        // runs of slices at the same position; k at every position means k
+        // phases, a few repeated positions are only duplicates
+        std::size_t positions = 0, longestRun = 0, shortestRun = slices.size();
+        for (auto it = slices.begin(); it != slices.end();) {
+            const auto end = slices.lower_bound({std::get<0>(it->first) + 1, std::numeric_limits<double>::lowest(),
+                                                 std::numeric_limits<int>::min(), std::numeric_limits<int>::min()});
+            const std::size_t run = std::distance(it, end);
+            longestRun = std::max(longestRun, run);
+            shortestRun = std::min(shortestRun, run);
+            ++positions;
+            it = end;
+        }
+
+        if (positions > 1 && longestRun > 1 && shortestRun == longestRun) {
+            // the i-th slice at each position belongs to phase i
+            phased = true;
+            std::vector<Part> phases(longestRun);
+            for (std::size_t p = 0; p < longestRun; ++p) phases[p] = {group, static_cast<int>(p) + 1, {}};
+            int64_t position = 0;
+            std::size_t indexInRun = 0;
+            for (auto it = slices.begin(); it != slices.end(); ++it) {
+                const int64_t here = std::get<0>(it->first);
+                indexInRun = (it == slices.begin() || here != position) ? 0 : indexInRun + 1;
+                position = here;
+                phases[indexInRun].entries.push_back(&it->second);
+            }
+            for (auto& part : phases) parts.push_back(std::move(part));
+        } else {
+            Part part{group, 0, {}};
+            part.entries.reserve(slices.size());
+            for (auto& kv : slices) part.entries.push_back(&kv.second);
+            parts.push_back(std::move(part));
+        }
+    }
+
+    std::vector<Stack> stacks;
+    const bool split = parts.size() > 1;
+    for (Part& part : parts) {
+        Stack stack;
+        stack.entries = std::move(part.entries);
+        stack.reversed = stack.entries.size() >= 2 &&
+                         reversedByInstance(stack.entries.front()->slice, stack.entries.back()->slice);
+        if (stack.reversed) std::reverse(stack.entries.begin(), stack.entries.end());
+        if (!split) {
+            stack.key = uid;
+            stacks.push_back(std::move(stack));
+            continue;
+        }
+
+        QStringList key, label;
+        const auto [orientation, echo, temporal] = part.group;
+        if (series.orientations.size() > 1) {
+            key << QString("o%1").arg(orientation + 1);
+            label << QString("orientation %1").arg(orientation + 1);
+        }
+        if (echoes.size() > 1) {
+            key << QString("e%1").arg(echo);
+            label << QString("echo %1").arg(echo);
+        }
+        if (temporals.size() > 1) {
+            key << QString("t%1").arg(temporal);
+            label << QString("time %1").arg(temporal);
+        }
+        if (phased && part.phase > 0) {
+            key << QString("p%1").arg(part.phase);
+            label << QString("phase %1").arg(part.phase);
+        }
+        stack.key = uid + "/" + key.join("");
+        stack.suffix = " (" + label.join(", ") + ")";
+        stacks.push_back(std::move(stack));
+    }
+    return stacks;
+}
+
+// Adds the stacks to `result`, moving the slices out of the sorter or
+// copying them (cheap: the strings are shared), and remembers them as
+// handed out
+void SeriesSorter::handOut(Series& series, std::vector<Stack>& stacks, bool copy, SeriesMap& result) {
+    series.handedKeys.clear();
+    series.handedReversed.clear();
+    for (std::size_t i = 0; i < stacks.size(); ++i) {
+        std::vector<SliceInfo> slices;
+        slices.reserve(stacks[i].entries.size());
+        for (Entry* e : stacks[i].entries) {
+            slices.push_back(copy ? e->slice : std::move(e->slice));
+            slices.back().seriesDesc += stacks[i].suffix;
+            e->handed = static_cast<int>(i);
+        }
+        result[stacks[i].key] = std::move(slices);
+        series.handedKeys.push_back(stacks[i].key);
+        series.handedReversed.push_back(stacks[i].reversed);
+    }
+    series.removed = false;
+}
+
+void applyStackUpdate(std::vector<SliceInfo>& stack, StackUpdate&& update) {
+    if (update.reset) {
+        stack = std::move(update.slices);
+        return;
+    }
+    // from the back, so every old slice moves at most once
+    std::size_t old = stack.size();
+    std::size_t next = update.slices.size();
+    stack.resize(old + next);
+    for (std::size_t z = stack.size(); z-- > 0 && next > 0;) {
+        if (update.positions[next - 1] == static_cast<int>(z))
+            stack[z] = std::move(update.slices[--next]);
+        else
+            stack[z] = std::move(stack[--old]);
+    }
+}
+
+} // namespace d3m
@@ -0,0 +1,90 @@
+#include "dicom/slice_prefetcher.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <vector>
+
+namespace d3m {
+
+SlicePrefetcher::SlicePrefetcher(int ahead, int behind) : m_ahead(ahead), m_behind(behind) {
+    // leave cores for the GUI thread and the series loader
+    m_readThreads = std::max(1, QThread::idealThreadCount() / 2);
+    m_decodeThreads = std::max(1, QThread::idealThreadCount() - 1);
+    m_pool.setMaxThreadCount(m_readThreads);
+}
+
+SlicePrefetcher::~SlicePrefetcher() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+void SlicePrefetcher::cancel() {
+    ++m_generation;
+    m_pool.clear();
+}
+
+void SlicePrefetcher::request(const std::shared_ptr<Volume>& volume, int center, int direction) {
+    cancel();
+    if (!volume) return;
+
+    const int step = direction < 0 ? -1 : 1;
+    // keep every decode thread busy on compressed data
+    const int ahead = volume->isCompressed() ? std::max(m_ahead, m_decodeThreads) : m_ahead;
+    std::vector<int> order;
+    order.reserve(ahead + m_behind);
+    for (int i = 1; i <= ahead; ++i)
+        order.push_back(center + step * i);
+    for (int i = 1; i <= m_behind; ++i)
+        order.push_back(center - step * i);
+
+    enqueue(volume, order);
+}
+
+void SlicePrefetcher::requestAll(const std::shared_ptr<Volume>& volume, int center) {
+    cancel();
+    if (!volume) return;
+
+    // a frame-cached volume only keeps so many frames: the nearest ones, or
+    // decoding the far ones would evict those around the center again
+    int reach = volume->depth();
+    if (volume->isFrameCached())
+        reach = static_cast<int>(Volume::FrameCacheBudget / (volume->sliceSize() * sizeof(uint16_t)) / 2);
+
+    std::vector<int> order{center};
+    order.reserve(2 * reach);
+    for (int i = 1; i < reach; ++i) {
+        order.push_back(center + i);
+        order.push_back(center - i);
+    }
+    enqueue(volume, order);
+}
+
+void SlicePrefetcher::requestRange(const std::shared_ptr<Volume>& volume, int first, int last, int center) {
+    cancel();
+    if (!volume) return;
+
+    std::vector<int> order{center};
+    order.reserve(2 * (last - first));
+    for (int i = 1; center - i >= first || center + i < last; ++i) {
+        if (center + i < last) order.push_back(center + i);
+        if (center - i >= first) order.push_back(center - i);
+    }
+    enqueue(volume, order);
+}
+
+void SlicePrefetcher::enqueue(const std::shared_ptr<Volume>& volume, const std::vector<int>& order) {
+    m_pool.setMaxThreadCount(volume->isCompressed() ? m_decodeThreads : m_readThreads);
+    const uint64_t generation = m_generation.load();
+    int priority = static_cast<int>(order.size());
+    for (int z : order) {
+        if (z < 0 || z >= volume->depth() || volume->isSliceLoaded(z)) continue;
+        // nearer slices get higher priority so they are decoded first
+        m_pool.start([this, volume, z, generation] {
+            if (m_generation.load() != generation) return; // superseded
+            volume->loadSlice(z);
+        }, priority--);
+    }
+}
+
+} // namespace d3m
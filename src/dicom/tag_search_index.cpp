@@ -0,0 +1,169 @@
+#include "dicom/tag_search_index.h"
+
+#include <QPair>
+#include <QStringList>
+
+#include <algorithm>
+#include <iterator>
+
+namespace d3m {
+
+static uint64_t trigram(const QString& s, qsizetype i) {
+    return (uint64_t(s[i].unicode()) << 32) | (uint64_t(s[i + 1].unicode()) << 16) | s[i + 2].unicode();
+}
+
+void TagSearchIndex::clear() {
+    m_seriesKeys.clear();
+    m_docs.clear();
+    m_trigrams.clear();
+    m_byTag.clear();
+    m_keywords.clear();
+    m_lastQuery.clear();
+    m_lastIsSubstring = false;
+    m_result.clear();
+}
+
+void TagSearchIndex::addSeries(const QString& seriesKey, const std::vector<SliceInfo>& slices) {
+    const int series = static_cast<int>(m_seriesKeys.size());
+    m_seriesKeys.push_back(seriesKey);
+    m_lastIsSubstring = false; // cached hits do not cover the new documents
+
+    QHash<QPair<uint32_t, QString>, int> docOf;
+    std::vector<uint64_t> grams;
+    for (int i = 0; i < static_cast<int>(slices.size()); ++i) {
+        for (const TagEntry& e : slices[i].tags) {
+            auto key = qMakePair(e.tag, e.value);
+            auto it = docOf.find(key);
+            if (it != docOf.end()) {
+                m_docs[it.value()].slices.push_back(i);
+                continue;
+            }
+
+            const int id = static_cast<int>(m_docs.size());
+            docOf.insert(key, id);
+
+            const QString keyword = tagKeyword(e.tag);
+            Document doc;
+            doc.series = series;
+            doc.tag = e.tag;
+            doc.value = e.value;
+            doc.text = (tagString(e.tag) + " " + keyword + " " + e.value).toLower();
+            doc.slices.push_back(i);
+
+            grams.clear();
+            for (qsizetype k = 0; k + 2 < doc.text.size(); ++k)
+                grams.push_back(trigram(doc.text, k));
+            std::sort(grams.begin(), grams.end());
+            grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+            for (uint64_t g : grams)
+                m_trigrams[g].push_back(id);
+
+            m_byTag[e.tag].push_back(id);
+            if (!keyword.isEmpty())
+                m_keywords.insert(keyword.toLower(), e.tag);
+            m_docs.push_back(std::move(doc));
+        }
+    }
+}
+
+bool TagSearchIndex::parseField(const QString& query, uint32_t& tag, QString& value) const {
+    const qsizetype eq = query.indexOf('=');
+    if (eq <= 0) return false;
+
+    QString field = query.left(eq).trimmed().toLower();
+    value = query.mid(eq + 1).trimmed();
+
+    auto kw = m_keywords.constFind(field);
+    if (kw != m_keywords.constEnd()) {
+        tag = kw.value();
+        return true;
+    }
+
+    // "(0018,0050)" or "0018,0050"
+    field.remove('(').remove(')');
+    const QStringList parts = field.split(',');
+    if (parts.size() != 2) return false;
+    bool okGroup = false;
+    bool okElement = false;
+    const uint group = parts[0].trimmed().toUInt(&okGroup, 16);
+    const uint element = parts[1].trimmed().toUInt(&okElement, 16);
+    if (!okGroup || !okElement || group > 0xFFFF || element > 0xFFFF) return false;
+    tag = tagKey(uint16_t(group), uint16_t(element));
+    return true;
+}
+
+std::vector<int> TagSearchIndex::searchField(uint32_t tag, const QString& value) const {
+    std::vector<int> hits;
+    auto it = m_byTag.find(tag);
+    if (it == m_byTag.end()) return hits;
+
+    bool wantNumeric = false;
+    const double wanted = value.toDouble(&wantNumeric);
+    for (int id : it->second) {
+        const QString v = m_docs[id].value.trimmed();
+        bool isNumeric = false;
+        const double d = wantNumeric ? v.toDouble(&isNumeric) : 0.0;
+        if (value.isEmpty() || (isNumeric && d == wanted) ||
+            v.compare(value, Qt::CaseInsensitive) == 0)
+            hits.push_back(id);
+    }
+    return hits;
+}
+
+std::vector<int> TagSearchIndex::searchSubstring(const QString& needle) const {
+    std::vector<int> hits;
+    if (needle.size() < 3) {
+        // too short for trigrams, the document list is small enough to scan
+        for (int id = 0; id < static_cast<int>(m_docs.size()); ++id) {
+            if (m_docs[id].text.contains(needle)) hits.push_back(id);
+        }
+        return hits;
+    }
+
+    // intersect the posting lists, smallest first
+    std::vector<const std::vector<int>*> lists;
+    for (qsizetype k = 0; k + 2 < needle.size(); ++k) {
+        auto it = m_trigrams.find(trigram(needle, k));
+        if (it == m_trigrams.end()) return hits;
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](auto* a, auto* b) { return a->size() < b->size(); });
+
+    std::vector<int> candidates = *lists.front();
+    std::vector<int> next;
+    for (std::size_t l = 1; l < lists.size() && !candidates.empty(); ++l) {
+        next.clear();
+        std::set_intersection(candidates.begin(), candidates.end(),
+                              lists[l]->begin(), lists[l]->end(), std::back_inserter(next));
+        candidates.swap(next);
+    }
+
+    // trigrams can match out of order, confirm the substring
+    for (int id : candidates) {
+        if (m_docs[id].text.contains(needle)) hits.push_back(id);
+    }
+    return hits;
+}
+
+const std::vector<int>& TagSearchIndex::search(const QString& query) {
+    uint32_t tag = 0;
+    QString value;
+    if (parseField(query, tag, value)) {
+        m_result = searchField(tag, value);
+        m_lastIsSubstring = false;
+        return m_result;
+    }
+
+    const QString needle = query.trimmed().toLower();
+    if (m_lastIsSubstring && !m_lastQuery.isEmpty() && needle.startsWith(m_lastQuery)) {
+        // refining the previous query: its hits are a superset
+        std::erase_if(m_result, [&](int id) { return !m_docs[id].text.contains(needle); });
+    } else {
+        m_result = searchSubstring(needle);
+    }
+    m_lastQuery = needle;
+    m_lastIsSubstring = true;
+    return m_result;
+}
+
+} // namespace d3m
@@ -0,0 +1,66 @@
+#include "dicom/tag_store.h"
+
+#include <gdcmDataSet.h>
+#include <gdcmDataElement.h>
+#include <gdcmDict.h>
+#include <gdcmDictEntry.h>
+#include <gdcmDicts.h>
+#include <gdcmFile.h>
+#include <gdcmGlobal.h>
+#include <gdcmStringFilter.h>
+
+#include <algorithm>
+
+namespace d3m {
+
+TagStore collectTags(const gdcm::File& file) {
+    const gdcm::DataSet& ds = file.GetDataSet();
+    gdcm::StringFilter sf;
+    sf.SetFile(file);
+
+    TagStore tags;
+    tags.reserve(ds.Size());
+    for (gdcm::DataSet::ConstIterator it = ds.Begin(); it != ds.End(); ++it) {
+        const gdcm::DataElement& de = *it;
+        const gdcm::Tag& tag = de.GetTag();
+        tags.push_back({tagKey(tag.GetGroup(), tag.GetElement()), QString::fromStdString(sf.ToString(de))});
+    }
+    return tags;
+}
+
+QString tagValue(const TagStore& tags, uint32_t tag) {
+    // stores are in tag order
+    const auto it = std::lower_bound(tags.begin(), tags.end(), tag,
+                                     [](const TagEntry& e, uint32_t t) { return e.tag < t; });
+    return it != tags.end() && it->tag == tag ? it->value : QString();
+}
+
+void internTags(std::vector<TagStore*>& stores) {
+    QSet<QString> pool;
+    for (TagStore* store : stores) {
+        for (TagEntry& e : *store)
+            e.value = *pool.insert(e.value);
+    }
+}
+
+static const gdcm::DictEntry& dictEntry(uint32_t tag) {
+    const gdcm::Dict& pubDict = gdcm::Global::GetInstance().GetDicts().GetPublicDict();
+    return pubDict.GetDictEntry(gdcm::Tag(uint16_t(tag >> 16), uint16_t(tag & 0xFFFF)));
+}
+
+QString tagString(uint32_t tag) {
+    return QString("(%1,%2)")
+        .arg(tag >> 16, 4, 16, QLatin1Char('0'))
+        .arg(tag & 0xFFFF, 4, 16, QLatin1Char('0'))
+        .toUpper();
+}
+
+QString tagKeyword(uint32_t tag) {
+    return QString::fromStdString(dictEntry(tag).GetKeyword());
+}
+
+QString tagVR(uint32_t tag) {
+    return QString::fromStdString(gdcm::VR::GetVRString(dictEntry(tag).GetVR()));
+}
+
+} // namespace d3m
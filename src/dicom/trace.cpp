@@ -0,0 +1,144 @@
+#include "dicom/trace.h"
+
+#include <QCoreApplication>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace d3m {
+
+Tracer& Tracer::instance() {
+    // never destroyed: pool threads may still exit, and hand back their
+    // rings, after static destruction has begun
+    static Tracer* tracer = new Tracer;
+    return *tracer;
+}
+
+int64_t Tracer::now() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Hands the ring back when its thread exits (an idle pool thread expires
+// after 30 s), for the next new thread to take over
+struct Tracer::BufferOwner {
+    ThreadBuffer* buffer = nullptr;
+    ~BufferOwner() {
+        if (buffer) Tracer::instance().releaseBuffer(buffer);
+    }
+};
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    thread_local BufferOwner owner;
+    if (owner.buffer) return *owner.buffer;
+
+    const bool gui = QCoreApplication::instance() &&
+                     QThread::currentThread() == QCoreApplication::instance()->thread();
+
+    std::lock_guard lock(m_mutex);
+    // a reused ring keeps the events of its earlier thread, under the same tid
+    if (!m_free.empty()) {
+        owner.buffer = m_free.back();
+        m_free.pop_back();
+    } else {
+        m_buffers.push_back(std::make_unique<ThreadBuffer>());
+        owner.buffer = m_buffers.back().get();
+        owner.buffer->tid = static_cast<int>(m_buffers.size());
+    }
+    std::lock_guard bufferLock(owner.buffer->mutex);
+    owner.buffer->name = gui ? QStringLiteral("GUI") : QString("worker %1").arg(owner.buffer->tid);
+    return *owner.buffer;
+}
+
+void Tracer::releaseBuffer(ThreadBuffer* buffer) {
+    std::lock_guard lock(m_mutex);
+    m_free.push_back(buffer);
+}
+
+void Tracer::record(const char* name, int64_t begin, int64_t end) {
+    ThreadBuffer& b = threadBuffer();
+    std::lock_guard lock(b.mutex);
+    if (b.events.size() < Capacity) {
+        b.events.push_back({name, begin, end});
+    } else {
+        b.events[b.next] = {name, begin, end};
+        b.next = (b.next + 1) % Capacity;
+    }
+}
+
+void Tracer::clear() {
+    std::lock_guard lock(m_mutex);
+    for (auto& b : m_buffers) {
+        std::lock_guard bufferLock(b->mutex);
+        b->events.clear();
+        b->next = 0;
+    }
+}
+
+TraceStats Tracer::stats(const char* name, int windowMs) const {
+    const int64_t since = now() - static_cast<int64_t>(windowMs) * 1000000;
+    std::vector<int64_t> durations;
+    {
+        std::lock_guard lock(m_mutex);
+        for (const auto& b : m_buffers) {
+            std::lock_guard bufferLock(b->mutex);
+            for (const Event& e : b->events) {
+                // literals may be duplicated across translation units, compare contents
+                if (e.end >= since && (e.name == name || std::strcmp(e.name, name) == 0))
+                    durations.push_back(e.end - e.begin);
+            }
+        }
+    }
+
+    TraceStats s;
+    s.count = static_cast<int>(durations.size());
+    if (durations.empty()) return s;
+    std::sort(durations.begin(), durations.end());
+    auto percentile = [&](double p) {
+        const std::size_t i = std::min(durations.size() - 1, static_cast<std::size_t>(p * durations.size()));
+        return durations[i] / 1e6;
+    };
+    s.p50 = percentile(0.50);
+    s.p95 = percentile(0.95);
+    s.p99 = percentile(0.99);
+    s.max = durations.back() / 1e6;
+    return s;
+}
+
+bool Tracer::exportChromeTrace(const QString& path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() -> QTextStream& {
+        if (!first) out << ",\n";
+        first = false;
+        return out;
+    };
+
+    std::lock_guard lock(m_mutex);
+    for (const auto& b : m_buffers) {
+        std::lock_guard bufferLock(b->mutex);
+        QString threadName = b->name;
+        threadName.replace('\\', "\\\\").replace('"', "\\\"");
+        separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+                    << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+        // complete events, timestamps in microseconds
+        for (const Event& e : b->events) {
+            separator() << "{\"name\":\"" << e.name << "\",\"cat\":\"d3m\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                        << ",\"ts\":" << QString::number(e.begin / 1e3, 'f', 3)
+                        << ",\"dur\":" << QString::number((e.end - e.begin) / 1e3, 'f', 3) << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.flush();
+    return file.commit();
+}
+
+} // namespace d3m
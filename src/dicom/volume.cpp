@@ -0,0 +1,516 @@
+#include "dicom/volume.h"
+#include "dicom/trace.h"
+
+#include <gdcmBoxRegion.h>
+#include <gdcmImageReader.h>
+#include <gdcmImageRegionReader.h>
+#include <gdcmImage.h>
+#include <gdcmPixelFormat.h>
+
+#include <QFile>
+#include <QSysInfo>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <utility>
+
+namespace d3m {
+
+static Vec3 cross(const Vec3& a, const Vec3& b) {
+    return {a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0]};
+}
+
+static double dot(const Vec3& a, const Vec3& b) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+Volume::Volume(const std::vector<SliceInfo>& slices) {
+    m_depth = static_cast<int>(slices.size());
+    if (m_depth == 0) return;
+
+    const SliceInfo& first = slices.front();
+    m_width = first.columns;
+    m_height = first.rows;
+    m_pixelType = first.pixelRepresentation == 1 ? PixelType::Int16 : PixelType::UInt16;
+    m_rescaleSlope = first.rescaleSlope;
+    m_rescaleIntercept = first.rescaleIntercept;
+
+    // a missing orientation keeps the axial default
+    if (first.rowCosX != 0.0 || first.rowCosY != 0.0 || first.rowCosZ != 0.0) {
+        m_rowCos = {first.rowCosX, first.rowCosY, first.rowCosZ};
+        m_colCos = {first.colCosX, first.colCosY, first.colCosZ};
+        m_normal = cross(m_rowCos, m_colCos);
+    }
+
+    // DICOM PixelSpacing is row spacing \ column spacing, i.e. (y, x)
+    if (first.pixelSpacingY > 0.0) m_spacing[0] = first.pixelSpacingY;
+    if (first.pixelSpacingX > 0.0) m_spacing[1] = first.pixelSpacingX;
+    m_sliceThickness = first.sliceThickness;
+
+    m_sources.reserve(slices.size());
+    bool mixed = false;
+    for (const auto& s : slices) {
+        m_sources.push_back(sourceOf(s));
+        if (!isUncompressedLittleEndian(s.transferSyntaxUID)) m_compressed = true;
+        mixed = mixed || s.rescaleSlope != first.rescaleSlope || s.rescaleIntercept != first.rescaleIntercept ||
+                s.pixelRepresentation != first.pixelRepresentation;
+    }
+    if (mixed) chooseCommonRescale();
+    m_slot.resize(slices.size());
+    std::iota(m_slot.begin(), m_slot.end(), 0);
+    updateStackGeometry();
+
+    m_capacity = m_depth;
+    m_state = std::make_unique<std::atomic<uint8_t>[]>(m_capacity);
+    m_counted.assign(slices.size(), 0);
+    m_histogram.reset(m_pixelType == PixelType::Int16);
+
+    const bool multiFrame = std::any_of(m_sources.begin(), m_sources.end(),
+                                        [](const Source& s) { return s.numberOfFrames > 1; });
+    m_frameCached = multiFrame && sizeInBytes() > FrameCacheBudget;
+    if (m_frameCached) {
+        m_frames.resize(slices.size());
+        m_lruPos.resize(slices.size());
+        return;
+    }
+
+    // one allocation for the whole series; pages are only committed once a
+    // slice is actually decoded into them
+    m_data = allocateSlab(m_capacity);
+}
+
+Volume::~Volume() = default;
+
+Volume::Source Volume::sourceOf(const SliceInfo& s) {
+    return {s.filePath, s.transferSyntaxUID, s.frameIndex, s.numberOfFrames,
+            s.bitsAllocated, s.bitsStored, s.pixelRepresentation == 1,
+            s.rescaleSlope, s.rescaleIntercept, {s.imagePosX, s.imagePosY, s.imagePosZ}};
+}
+
+std::shared_ptr<uint16_t[]> Volume::allocateSlab(std::size_t slices) const {
+    const std::size_t bytes = std::max<std::size_t>(sliceSize() * slices * sizeof(uint16_t), 1);
+    return std::shared_ptr<uint16_t[]>(static_cast<uint16_t*>(::operator new(bytes, std::align_val_t{Alignment})),
+                                       AlignedDelete{});
+}
+
+// Origin and slice step from the first two slices in stack order: spacing
+// from their positions along the normal, the thickness as fallback
+void Volume::updateStackGeometry() {
+    const Vec3& first = m_sources[m_slot[0]].position;
+    m_origin = first;
+    double dz = 0.0;
+    Vec3 d = {0.0, 0.0, 0.0};
+    if (m_depth > 1) {
+        const Vec3& second = m_sources[m_slot[1]].position;
+        d = {second[0] - first[0], second[1] - first[1], second[2] - first[2]};
+        dz = std::abs(dot(d, m_normal));
+    }
+    if (dz > 0.0) m_spacing[2] = dz;
+    else if (m_sliceThickness > 0.0) m_spacing[2] = m_sliceThickness;
+    if (dz > 0.0)
+        m_sliceStep = d;
+    else
+        m_sliceStep = {m_normal[0] * m_spacing[2], m_normal[1] * m_spacing[2], m_normal[2] * m_spacing[2]};
+}
+
+bool Volume::loadSlice(int z) {
+    int slot = 0;
+    {
+        std::unique_lock lock(m_mutex);
+        if (z < 0 || z >= m_depth) return false;
+        slot = m_slot[z];
+        m_loadedCv.wait(lock, [&] { return m_state[slot].load() != Loading; });
+        if (m_state[slot].load() == Ready) return true;
+        m_state[slot].store(Loading);
+        ++m_loading;
+    }
+
+    // the slot is ours until it is published, no lock needed for its buffer
+    if (m_frameCached) m_frames[slot].reset(new uint16_t[sliceSize()]);
+    const bool ok = decodeInto(slot);
+    publish(slot, ok);
+    return ok;
+}
+
+Volume::SliceRef Volume::sliceRef(int z) const {
+    std::lock_guard lock(m_mutex);
+    if (z < 0 || z >= m_depth) return {};
+    const int slot = m_slot[z];
+    if (m_state[slot].load() != Ready) return {};
+    // the slab stays alive while the slice is held, even if the volume grows
+    if (!m_frameCached) return SliceRef(m_data, m_data.get() + sliceSize() * slot);
+    m_lru.splice(m_lru.begin(), m_lru, m_lruPos[slot]);
+    return m_frames[slot];
+}
+
+// Marks a slice decoded (or not) and wakes whoever waits for it. Frames past
+// the budget are evicted least recently used first; holders of a SliceRef
+// keep theirs until they let go.
+void Volume::publish(int slot, bool ok) {
+    // counted once, before the slice shows as loaded, on the decoding thread
+    if (ok && !m_counted[slot]) {
+        m_histogram.addSlice(slice(slot), sliceSize());
+        m_counted[slot] = 1;
+    }
+    {
+        std::lock_guard lock(m_mutex);
+        --m_loading;
+        if (!ok && m_frameCached) m_frames[slot].reset();
+        m_state[slot].store(ok ? Ready : Empty, std::memory_order_release);
+        if (ok) ++m_loadedCount;
+        if (ok && m_frameCached) {
+            m_lruPos[slot] = m_lru.insert(m_lru.begin(), slot);
+            const std::size_t frameBytes = sliceSize() * sizeof(uint16_t);
+            while (m_lru.size() > 1 && m_lru.size() * frameBytes > FrameCacheBudget) {
+                const int victim = m_lru.back();
+                m_lru.pop_back();
+                m_frames[victim].reset();
+                m_state[victim].store(Empty, std::memory_order_release);
+                --m_loadedCount;
+            }
+        }
+    }
+    m_loadedCv.notify_all();
+}
+
+int Volume::adoptSlices(const Volume& other, const std::set<QString>& changed) {
+    if (other.m_width != m_width || other.m_height != m_height || other.m_pixelType != m_pixelType ||
+        other.m_rescaleSlope != m_rescaleSlope || other.m_rescaleIntercept != m_rescaleIntercept)
+        return 0;
+
+    std::map<std::pair<QString, int>, int> decoded;
+    for (int z = 0; z < other.m_depth; ++z) {
+        const Source& src = other.m_sources[other.m_slot[z]];
+        if (other.isSliceLoaded(z) && !changed.count(src.filePath))
+            decoded.emplace(std::make_pair(src.filePath, src.frameIndex), z);
+    }
+
+    int adopted = 0;
+    for (int slot = 0; slot < static_cast<int>(m_sources.size()) && !decoded.empty(); ++slot) {
+        auto it = decoded.find({m_sources[slot].filePath, m_sources[slot].frameIndex});
+        if (it == decoded.end()) continue;
+        const SliceRef pixels = other.sliceRef(it->second);
+        if (!pixels) continue;
+        {
+            std::lock_guard lock(m_mutex);
+            if (m_state[slot].load() != Empty) continue;
+            m_state[slot].store(Loading);
+            ++m_loading;
+        }
+        if (m_frameCached) m_frames[slot].reset(new uint16_t[sliceSize()]);
+        std::memcpy(slice(slot), pixels.get(), sliceSize() * sizeof(uint16_t));
+        publish(slot, true);
+        ++adopted;
+    }
+    return adopted;
+}
+
+// A slice can join without touching the decoded ones if its values map
+// into the volume's rescale at no loss of precision
+bool Volume::fitsRescale(const SliceInfo& s) const {
+    const bool isSigned = s.pixelRepresentation == 1;
+    if (s.rescaleSlope == m_rescaleSlope && s.rescaleIntercept == m_rescaleIntercept &&
+        isSigned == (m_pixelType == PixelType::Int16))
+        return true;
+    if (std::abs(s.rescaleSlope) < std::abs(m_rescaleSlope)) return false;
+
+    const int bits = std::clamp(s.bitsStored, 1, 16);
+    const double vmin = isSigned ? -std::ldexp(1.0, bits - 1) : 0.0;
+    const double vmax = isSigned ? std::ldexp(1.0, bits - 1) - 1.0 : std::ldexp(1.0, bits) - 1.0;
+    const double a = vmin * s.rescaleSlope + s.rescaleIntercept;
+    const double b = vmax * s.rescaleSlope + s.rescaleIntercept;
+    const bool volumeSigned = m_pixelType == PixelType::Int16;
+    const double lo = (volumeSigned ? -32768.0 : 0.0) * m_rescaleSlope + m_rescaleIntercept;
+    const double hi = (volumeSigned ? 32767.0 : 65535.0) * m_rescaleSlope + m_rescaleIntercept;
+    return std::min(a, b) >= std::min(lo, hi) && std::max(a, b) <= std::max(lo, hi);
+}
+
+bool Volume::insertSlices(const std::vector<int>& positions, const std::vector<SliceInfo>& slices) {
+    const std::size_t k = slices.size();
+    if (k == 0) return true;
+    if (m_depth == 0 || positions.size() != k) return false;
+    for (std::size_t i = 0; i < k; ++i) {
+        if (positions[i] < 0 || positions[i] >= m_depth + static_cast<int>(k) ||
+            (i > 0 && positions[i] <= positions[i - 1]))
+            return false;
+        if (slices[i].columns != m_width || slices[i].rows != m_height || !fitsRescale(slices[i]))
+            return false;
+    }
+
+    std::unique_lock lock(m_mutex);
+    // nothing may be decoding while the tables move; new loads wait on the lock
+    m_loadedCv.wait(lock, [&] { return m_loading == 0; });
+
+    const std::size_t used = m_sources.size();
+    if (used + k > m_capacity) {
+        // grows geometrically, so a stack that streams in is copied O(1) times per slice
+        const std::size_t capacity = std::max(used + k, 2 * m_capacity);
+        auto state = std::make_unique<std::atomic<uint8_t>[]>(capacity);
+        for (std::size_t s = 0; s < used; ++s) state[s].store(m_state[s].load());
+        if (!m_frameCached) {
+            // holders of a SliceRef keep the old slab until they let go
+            auto data = allocateSlab(capacity);
+            for (std::size_t s = 0; s < used; ++s) {
+                if (state[s].load() == Ready)
+                    std::memcpy(data.get() + sliceSize() * s, m_data.get() + sliceSize() * s, sliceSize() * sizeof(uint16_t));
+            }
+            m_data = std::move(data);
+        }
+        m_state = std::move(state);
+        m_capacity = capacity;
+    }
+
+    for (const SliceInfo& s : slices) {
+        m_sources.push_back(sourceOf(s));
+        if (!isUncompressedLittleEndian(s.transferSyntaxUID)) m_compressed = true;
+    }
+    m_counted.resize(m_sources.size(), 0);
+    if (m_frameCached) {
+        m_frames.resize(m_sources.size());
+        m_lruPos.resize(m_sources.size());
+    }
+
+    // new slices take the new slots, at their positions in the stack
+    std::vector<int> order(m_depth + k);
+    std::size_t next = 0, old = 0;
+    for (std::size_t z = 0; z < order.size(); ++z) {
+        if (next < k && positions[next] == static_cast<int>(z))
+            order[z] = static_cast<int>(used + next++);
+        else
+            order[z] = m_slot[old++];
+    }
+    m_slot = std::move(order);
+    m_depth += static_cast<int>(k);
+    updateStackGeometry();
+    return true;
+}
+
+// Uncompressed little endian files: map the file and read the stored values
+// straight from the Pixel Data element into the slab, skipping GDCM's
+// intermediate buffers. Pixel Data is located from the end of the file and
+// verified against its element header; anything unexpected (trailing
+// elements, odd layouts) returns false and takes the GDCM path instead.
+// Of a multi-frame file only the one frame is mapped, so multi-GB files
+// never need to fit in memory.
+bool Volume::readMapped(int slot) {
+    D3M_TRACE_SCOPE("read.mapped");
+    const Source& src = m_sources[slot];
+    if (QSysInfo::ByteOrder != QSysInfo::LittleEndian) return false;
+    if (src.bitsAllocated != 16 && src.bitsAllocated != 8) return false;
+
+    const bool explicitVR = src.transferSyntaxUID == QLatin1String(ExplicitVRLittleEndianUID);
+
+    const qint64 frameLength = static_cast<qint64>(sliceSize()) * (src.bitsAllocated / 8);
+    const qint64 length = frameLength * src.numberOfFrames;
+    const qint64 encoded = (length + 1) & ~qint64(1); // element values have even length
+    const qint64 header = explicitVR ? 12 : 8;
+
+    QFile f(src.filePath);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    const qint64 start = f.size() - encoded - header;
+    if (start < 0) return false;
+
+    // (7FE0,0010) [OW|OB 00 00] <length>
+    uchar head[12];
+    if (!f.seek(start) || f.read(reinterpret_cast<char*>(head), header) != header) return false;
+    bool ok = head[0] == 0xE0 && head[1] == 0x7F && head[2] == 0x10 && head[3] == 0x00;
+    if (ok && explicitVR)
+        ok = head[4] == 'O' && (head[5] == 'W' || head[5] == 'B') && head[6] == 0 && head[7] == 0;
+    quint32 vl = 0;
+    if (ok) {
+        std::memcpy(&vl, head + header - 4, sizeof(vl));
+        ok = vl == encoded;
+    }
+    if (!ok) return false;
+
+    uchar* map = f.map(start + header + frameLength * src.frameIndex, frameLength);
+    if (!map) return false;
+
+    const uchar* pixels = map;
+    uint16_t* dst = slice(slot);
+    const std::size_t n = sliceSize();
+    if (src.bitsAllocated == 16)
+        std::memcpy(dst, pixels, n * sizeof(uint16_t));
+    else
+        std::copy(pixels, pixels + n, dst);
+
+    f.unmap(map);
+    return true;
+}
+
+// Slices disagree on their rescale or signedness: one rescale for the
+// volume that holds the modality range of every slice, at least as fine as
+// the finest slope, with unsigned values counted up from the lowest
+void Volume::chooseCommonRescale() {
+    double lo = std::numeric_limits<double>::max();
+    double hi = std::numeric_limits<double>::lowest();
+    double finest = std::numeric_limits<double>::max();
+    for (const Source& s : m_sources) {
+        const int bits = std::clamp(s.bitsStored, 1, 16);
+        const double vmin = s.isSigned ? -std::ldexp(1.0, bits - 1) : 0.0;
+        const double vmax = s.isSigned ? std::ldexp(1.0, bits - 1) - 1.0 : std::ldexp(1.0, bits) - 1.0;
+        const double a = vmin * s.rescaleSlope + s.rescaleIntercept;
+        const double b = vmax * s.rescaleSlope + s.rescaleIntercept;
+        lo = std::min({lo, a, b});
+        hi = std::max({hi, a, b});
+        finest = std::min(finest, std::abs(s.rescaleSlope));
+    }
+    m_pixelType = PixelType::UInt16;
+    m_rescaleIntercept = lo;
+    m_rescaleSlope = std::max(finest, (hi - lo) / 65535.0);
+}
+
+// Every decode path ends here, so mapped, GDCM and per-frame reads all give
+// the same values: bits above the slice's Bits Stored (overlay planes,
+// garbage) are dropped, signed data is sign-extended to 16 bits, and a
+// slice with its own rescale is brought to the volume's
+void Volume::finishSlice(int slot) {
+    const Source& src = m_sources[slot];
+    uint16_t* dst = slice(slot);
+    const std::size_t n = sliceSize();
+    const int bits = src.bitsStored;
+    if (bits > 0 && bits < 16) {
+        const int shift = 16 - bits;
+        if (src.isSigned) {
+            for (std::size_t i = 0; i < n; ++i)
+                dst[i] = static_cast<uint16_t>(static_cast<int16_t>(dst[i] << shift) >> shift);
+        } else {
+            const uint16_t mask = static_cast<uint16_t>((1u << bits) - 1);
+            for (std::size_t i = 0; i < n; ++i)
+                dst[i] &= mask;
+        }
+    }
+
+    const bool isSigned = m_pixelType == PixelType::Int16;
+    if (src.rescaleSlope == m_rescaleSlope && src.rescaleIntercept == m_rescaleIntercept && src.isSigned == isSigned)
+        return;
+    const double scale = src.rescaleSlope / m_rescaleSlope;
+    const double offset = (src.rescaleIntercept - m_rescaleIntercept) / m_rescaleSlope;
+    const double lo = isSigned ? -32768.0 : 0.0;
+    const double hi = isSigned ? 32767.0 : 65535.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double v = (src.isSigned ? static_cast<int16_t>(dst[i]) : dst[i]) * scale + offset;
+        dst[i] = static_cast<uint16_t>(static_cast<int>(std::lround(std::clamp(v, lo, hi))));
+    }
+}
+
+// Readers of multi-frame files with their header already parsed. A reader
+// is only used by one thread at a time; decode threads working on the same
+// file each get their own, so the header is parsed once per thread, not
+// once per frame.
+std::unique_ptr<gdcm::ImageRegionReader> Volume::takeReader(const QString& filePath) {
+    {
+        std::lock_guard lock(m_readerMutex);
+        auto it = m_readers.find(filePath);
+        if (it != m_readers.end()) {
+            auto reader = std::move(it->second);
+            m_readers.erase(it);
+            return reader;
+        }
+    }
+    auto reader = std::make_unique<gdcm::ImageRegionReader>();
+    reader->SetFileName(filePath.toStdString().c_str());
+    D3M_TRACE_SCOPE("read.gdcm");
+    if (!reader->ReadInformation()) return nullptr;
+    return reader;
+}
+
+void Volume::returnReader(const QString& filePath, std::unique_ptr<gdcm::ImageRegionReader> reader) {
+    std::lock_guard lock(m_readerMutex);
+    m_readers.emplace(filePath, std::move(reader));
+}
+
+// Compressed (or otherwise unmappable) multi-frame files: let GDCM decode
+// just the frame's region instead of the whole pixel data element
+bool Volume::readFrameRegion(int slot) {
+    const Source& src = m_sources[slot];
+    auto reader = takeReader(src.filePath);
+    if (!reader) return false;
+    const bool ok = readFrame(*reader, slot);
+    returnReader(src.filePath, std::move(reader));
+    return ok;
+}
+
+bool Volume::readFrame(gdcm::ImageRegionReader& r, int slot) {
+    const Source& src = m_sources[slot];
+    const gdcm::Image& gimg = r.GetImage();
+    const unsigned int* dims = gimg.GetDimensions();
+    if (static_cast<int>(dims[0]) != m_width || static_cast<int>(dims[1]) != m_height)
+        return false;
+    const gdcm::PixelFormat& pf = gimg.GetPixelFormat();
+    if (pf.GetSamplesPerPixel() != 1) return false;
+
+    gdcm::BoxRegion box;
+    box.SetDomain(0, m_width - 1, 0, m_height - 1, src.frameIndex, src.frameIndex);
+    r.SetRegion(box);
+
+    uint16_t* dst = slice(slot);
+    const std::size_t n = sliceSize();
+    const std::size_t length = r.ComputeBufferLength();
+    if (pf.GetBitsAllocated() == 16) {
+        if (length != n * sizeof(uint16_t)) return false;
+        return r.ReadIntoBuffer(reinterpret_cast<char*>(dst), length);
+    }
+    if (pf.GetBitsAllocated() == 8) {
+        std::vector<char> buffer(length);
+        if (length != n || !r.ReadIntoBuffer(buffer.data(), length)) return false;
+        const auto* src8 = reinterpret_cast<const unsigned char*>(buffer.data());
+        std::copy(src8, src8 + n, dst);
+        return true;
+    }
+    return false;
+}
+
+bool Volume::decodeInto(int slot) {
+    D3M_TRACE_SCOPE("decode");
+    bool ok = false;
+    if (isUncompressedLittleEndian(m_sources[slot].transferSyntaxUID) && readMapped(slot))
+        ok = true;
+    else if (m_sources[slot].numberOfFrames > 1)
+        ok = readFrameRegion(slot);
+    else
+        ok = readWhole(slot);
+    if (ok) finishSlice(slot);
+    return ok;
+}
+
+bool Volume::readWhole(int slot) {
+
+    gdcm::ImageReader r;
+    r.SetFileName(m_sources[slot].filePath.toStdString().c_str());
+    {
+        D3M_TRACE_SCOPE("read.gdcm");
+        if (!r.Read()) return false;
+    }
+
+    const gdcm::Image& gimg = r.GetImage();
+    const unsigned int* dims = gimg.GetDimensions();
+    if (static_cast<int>(dims[0]) != m_width || static_cast<int>(dims[1]) != m_height)
+        return false;
+
+    const gdcm::PixelFormat& pf = gimg.GetPixelFormat();
+    if (pf.GetSamplesPerPixel() != 1) return false;
+
+    uint16_t* dst = slice(slot);
+    const std::size_t n = sliceSize();
+    if (pf.GetBitsAllocated() == 16) {
+        if (gimg.GetBufferLength() != n * sizeof(uint16_t)) return false;
+        // decode straight into the slab
+        if (!gimg.GetBuffer(reinterpret_cast<char*>(dst))) return false;
+    } else if (pf.GetBitsAllocated() == 8) {
+        std::vector<char> buffer(gimg.GetBufferLength());
+        if (buffer.size() != n || !gimg.GetBuffer(buffer.data())) return false;
+        const auto* src = reinterpret_cast<const unsigned char*>(buffer.data());
+        std::copy(src, src + n, dst);
+    } else {
+        // unsupported format for now..
+        return false;
+    }
+    return true;
+}
+
+} // namespace d3m
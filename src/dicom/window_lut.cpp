@@ -0,0 +1,69 @@
+#include "dicom/window_lut.h"
+#include "dicom/trace.h"
+
+#include <algorithm>
+
+namespace d3m {
+
+WindowLut::WindowLut() : m_table(Size, 0) {}
+
+bool WindowLut::update(const Volume& volume, int windowCenter, int windowWidth) {
+    return update(volume.pixelType(), volume.rescaleSlope(), volume.rescaleIntercept(),
+                  windowCenter, windowWidth);
+}
+
+bool WindowLut::update(PixelType type, double slope, double intercept, int windowCenter, int windowWidth) {
+    if (m_valid && m_type == type && m_slope == slope && m_intercept == intercept &&
+        m_windowCenter == windowCenter && m_windowWidth == windowWidth)
+        return false;
+
+    D3M_TRACE_SCOPE("lut.update");
+    m_valid = true;
+    m_type = type;
+    m_slope = slope;
+    m_intercept = intercept;
+    m_windowCenter = windowCenter;
+    m_windowWidth = windowWidth;
+
+    // out = (stored * slope + intercept - minWin) / ww * 255, folded into one multiply-add
+    const double ww = std::max(windowWidth, 1);
+    const double minWin = windowCenter - ww / 2.0;
+    const double scale = slope / ww * 255.0;
+    const double offset = (intercept - minWin) / ww * 255.0;
+
+    const bool isSigned = type == PixelType::Int16;
+    for (std::size_t i = 0; i < Size; ++i) {
+        const uint16_t raw = static_cast<uint16_t>(i);
+        const int stored = isSigned ? static_cast<int16_t>(raw) : raw;
+        const double v = stored * scale + offset;
+        m_table[i] = static_cast<uint8_t>(std::clamp(v, 0.0, 255.0));
+    }
+    return true;
+}
+
+void WindowLut::apply(const uint16_t* src, uchar* dst, std::size_t n) const {
+    const uint8_t* table = m_table.data();
+    for (std::size_t i = 0; i < n; ++i)
+        dst[i] = table[src[i]];
+}
+
+QImage renderSlice(const Volume& volume, int z, const WindowLut& lut) {
+    D3M_TRACE_SCOPE("window");
+    const int w = volume.width();
+    const int h = volume.height();
+    QImage img(w, h, QImage::Format_Grayscale8);
+    const Volume::SliceRef pixels = volume.sliceRef(z);
+    if (!pixels) {
+        img.fill(Qt::black);
+        return img;
+    }
+
+    const uint16_t* src = pixels.get();
+    for (int y = 0; y < h; ++y) {
+        // rows are written bottom-up, matching the previous flipped() output
+        lut.apply(src + static_cast<std::size_t>(y) * w, img.scanLine(h - 1 - y), w);
+    }
+    return img;
+}
+
+} // namespace d3m
@@ -0,0 +1,56 @@
+#include "gui/histogram_widget.h"
+
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+
+HistogramWidget::HistogramWidget(QWidget* parent) : QWidget(parent) {
+    setMinimumHeight(60);
+}
+
+void HistogramWidget::setHistogram(std::vector<int64_t> bins, double min, double binWidth) {
+    m_bins = std::move(bins);
+    m_min = min;
+    m_binWidth = binWidth > 0.0 ? binWidth : 1.0;
+    update();
+}
+
+void HistogramWidget::setRange(double low, double high) {
+    m_hasRange = true;
+    m_low = low;
+    m_high = high;
+    update();
+}
+
+void HistogramWidget::clear() {
+    m_bins.clear();
+    m_hasRange = false;
+    update();
+}
+
+// Log-scaled counts, so the few bins of a large background don't flatten the rest
+void HistogramWidget::paintEvent(QPaintEvent*) {
+    QPainter p(this);
+    p.fillRect(rect(), QColor(24, 24, 24));
+    if (m_bins.empty()) return;
+
+    const int n = static_cast<int>(m_bins.size());
+    const double span = n * m_binWidth;
+    const auto toX = [&](double value) { return (value - m_min) / span * width(); };
+
+    if (m_hasRange) {
+        const double x0 = std::clamp(toX(m_low), 0.0, double(width()));
+        const double x1 = std::clamp(toX(m_high), 0.0, double(width()));
+        p.fillRect(QRectF(x0, 0, x1 - x0, height()), QColor(60, 60, 90));
+    }
+
+    const double top = std::log1p(static_cast<double>(*std::max_element(m_bins.begin(), m_bins.end())));
+    if (top <= 0.0) return;
+    const double barWidth = static_cast<double>(width()) / n;
+    for (int i = 0; i < n; ++i) {
+        if (m_bins[i] == 0) continue;
+        const double h = std::log1p(static_cast<double>(m_bins[i])) / top * (height() - 1);
+        p.fillRect(QRectF(i * barWidth, height() - h, std::max(barWidth, 1.0), h), QColor(150, 200, 150));
+    }
+}
@@ -1,4 +1,5 @@
 #include "gui/main_window.h"
+#include "gui/tiled_image_item.h"
 #include "dicom/dicom_utils.h"
 #include <QHBoxLayout>
 #include <QVBoxLayout>
@@ -33,49 +34,175 @@
 #include <gdcmDict.h>
 #include <gdcmDictEntry.h>
 
+#include <cmath>
 #include <optional>
 
 ImageView::ImageView(QWidget* parent) : QGraphicsView(parent) {
     m_scene = new QGraphicsScene(this);
+    // a handful of items that never move: the BSP index only costs rebuilds
+    m_scene->setItemIndexMethod(QGraphicsScene::NoIndex);
     setScene(m_scene);
     setDragMode(QGraphicsView::ScrollHandDrag);
     setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
-}
 
-void ImageView::loadBaseImage(const QImage& img) {
-    m_scene->clear();
-    m_baseItem = m_scene->addPixmap(QPixmap::fromImage(img));
-    m_baseItem->setZValue(0);
-    m_scene->setSceneRect(m_baseItem->boundingRect());
-    // recreate overlay item placeholder
+    // base and overlay items live as long as the view; images only swap their pixmaps.
+    // Large images are drawn by the tiled item instead, which is then the base.
+    m_pixmapItem = m_scene->addPixmap(QPixmap());
+    m_pixmapItem->setZValue(0);
+    m_tiledItem = new TiledImageItem;
+    m_tiledItem->setZValue(0);
+    m_tiledItem->setVisible(false);
+    m_scene->addItem(m_tiledItem);
+    m_baseItem = m_pixmapItem;
     m_overlayItem = m_scene->addPixmap(QPixmap());
     m_overlayItem->setZValue(1);
 }
 
-void ImageView::loadOverlayImage(const QImage& img) {
-    if (!m_overlayItem) {
-        m_overlayItem = m_scene->addPixmap(QPixmap::fromImage(img));
-        m_overlayItem->setZValue(1);
-    } else {
-        m_overlayItem->setPixmap(QPixmap::fromImage(img));
+bool ImageView::wantsTiles(const QSize& size) {
+    return static_cast<qint64>(size.width()) * size.height() > TiledPixels;
+}
+
+void ImageView::loadBaseImage(const QImage& img) {
+    if (!wantsTiles(img.size())) {
+        loadBaseImage(QPixmap::fromImage(img));
+        return;
+    }
+    clearRois();
+    m_overlayItem->setPixmap(QPixmap());
+    setBase(m_tiledItem);
+    m_tiledItem->setImage(img);
+    m_imageSize = img.size();
+    resetGeometry();
+}
+
+// A new image: the overlay and ROIs belonged to the old one
+void ImageView::loadBaseImage(const QPixmap& pixmap) {
+    clearRois();
+    m_overlayItem->setPixmap(QPixmap());
+    setBase(m_pixmapItem);
+    m_pixmapItem->setPixmap(pixmap);
+    m_imageSize = pixmap.size();
+    resetGeometry();
+}
+
+void ImageView::updateBaseImage(const QImage& img) {
+    if (!wantsTiles(img.size())) {
+        updateBaseImage(QPixmap::fromImage(img));
+        return;
     }
+    const bool resized = m_baseItem != m_tiledItem || m_imageSize != img.size();
+    setBase(m_tiledItem);
+    m_tiledItem->setImage(img);
+    m_imageSize = img.size();
+    if (resized) resetGeometry();
+}
+
+// Next slice of the same stack: overlay, ROIs, zoom and pan all stay
+void ImageView::updateBaseImage(const QPixmap& pixmap) {
+    const bool resized = m_baseItem != m_pixmapItem || m_imageSize != pixmap.size();
+    setBase(m_pixmapItem);
+    m_pixmapItem->setPixmap(pixmap);
+    m_imageSize = pixmap.size();
+    if (resized) resetGeometry();
+}
+
+// Only one of the two base items is shown; the crosshair follows it
+void ImageView::setBase(QGraphicsItem* item) {
+    if (item == m_baseItem) return;
+    m_baseItem->setVisible(false);
+    if (m_baseItem == m_pixmapItem) m_pixmapItem->setPixmap(QPixmap());
+    else m_tiledItem->setImage(QImage());
+    if (m_hLine) m_hLine->setParentItem(item);
+    if (m_vLine) m_vLine->setParentItem(item);
+    item->setVisible(true);
+    m_baseItem = item;
+}
+
+void ImageView::resetGeometry() {
+    m_baseItem->setTransform(QTransform::fromScale(1.0, m_pixelAspect));
+    m_overlayItem->setTransform(m_baseItem->transform());
+    m_scene->setSceneRect(m_baseItem->sceneBoundingRect());
+    updateCrosshair();
+    fitInView(m_scene->sceneRect(), Qt::KeepAspectRatio);
+}
+
+void ImageView::loadOverlayImage(const QImage& img) {
+    m_overlayItem->setPixmap(QPixmap::fromImage(img));
     // align overlay to scene rect
-    if (m_baseItem) {
-        m_overlayItem->setPos(m_baseItem->pos());
+    m_overlayItem->setPos(m_baseItem->pos());
+}
+
+void ImageView::clearRois() {
+    // ROI rectangles are the items at z 2
+    for (QGraphicsItem* item : m_scene->items()) {
+        if (item->zValue() == 2) {
+            m_scene->removeItem(item);
+            delete item;
+        }
     }
+    m_currentRect = nullptr;
 }
 
 void ImageView::setOverlayOpacity(qreal o) {
-    if (m_overlayItem) m_overlayItem->setOpacity(o);
+    m_overlayItem->setOpacity(o);
 }
 
 void ImageView::setOverlayVisible(bool v) {
-    if (m_overlayItem) m_overlayItem->setVisible(v);
+    m_overlayItem->setVisible(v);
 }
 
 void ImageView::setDrawingEnabled(bool enabled) {
     m_drawingEnabled = enabled;
-    setCursor(enabled ? Qt::CrossCursor : Qt::ArrowCursor);
+    setCursor(enabled || m_crosshairEnabled ? Qt::CrossCursor : Qt::ArrowCursor);
+}
+
+void ImageView::setPixelAspect(qreal aspect) {
+    if (aspect <= 0.0 || aspect == m_pixelAspect) return;
+    m_pixelAspect = aspect;
+    if (!m_imageSize.isEmpty()) resetGeometry();
+}
+
+void ImageView::setCrosshairEnabled(bool enabled) {
+    m_crosshairEnabled = enabled;
+    setDragMode(enabled ? QGraphicsView::NoDrag : QGraphicsView::ScrollHandDrag);
+    setCursor(enabled || m_drawingEnabled ? Qt::CrossCursor : Qt::ArrowCursor);
+    updateCrosshair();
+}
+
+void ImageView::setCrosshair(const QPointF& imagePos) {
+    m_crosshairPos = imagePos;
+    updateCrosshair();
+}
+
+// Lines are children of the base item, so they follow its pixel aspect and
+// are drawn through the pixel centre
+void ImageView::updateCrosshair() {
+    if (!m_crosshairEnabled) {
+        if (m_hLine) m_hLine->setVisible(false);
+        if (m_vLine) m_vLine->setVisible(false);
+        return;
+    }
+    if (!m_hLine) {
+        QPen pen(Qt::green);
+        pen.setCosmetic(true);
+        m_hLine = new QGraphicsLineItem(m_baseItem);
+        m_vLine = new QGraphicsLineItem(m_baseItem);
+        m_hLine->setPen(pen);
+        m_vLine->setPen(pen);
+        m_hLine->setZValue(3);
+        m_vLine->setZValue(3);
+    }
+    const QRectF r = m_baseItem->boundingRect();
+    const qreal x = std::floor(m_crosshairPos.x()) + 0.5;
+    const qreal y = std::floor(m_crosshairPos.y()) + 0.5;
+    m_hLine->setLine(r.left(), y, r.right(), y);
+    m_vLine->setLine(x, r.top(), x, r.bottom());
+    m_hLine->setVisible(true);
+    m_vLine->setVisible(true);
+}
+
+void ImageView::emitCrosshairAt(const QPoint& viewPos) {
+    emit crosshairMoved(m_baseItem->mapFromScene(mapToScene(viewPos)));
 }
 
 // Mouse events: simple rectangle drawing in scene coordinates
@@ -91,6 +218,16 @@ void ImageView::mousePressEvent(QMouseEvent* event) {
         m_currentRect->setZValue(2);
         return; // eat event while drawing
     }
+    if (m_crosshairEnabled && event->button() == Qt::LeftButton) {
+        m_crosshairDrag = true;
+        emitCrosshairAt(event->pos());
+        return;
+    }
+    if (event->button() == Qt::RightButton) {
+        m_windowLevelDrag = true;
+        m_lastDragPos = event->pos();
+        return;
+    }
     QGraphicsView::mousePressEvent(event);
 }
 
@@ -100,6 +237,17 @@ void ImageView::mouseMoveEvent(QMouseEvent* event) {
         QRectF r(m_startScenePoint, cur);
         r = r.normalized();
         m_currentRect->setRect(r);
+        emit roiChanged(m_baseItem->mapFromScene(r).boundingRect());
+        return;
+    }
+    if (m_crosshairDrag) {
+        emitCrosshairAt(event->pos());
+        return;
+    }
+    if (m_windowLevelDrag) {
+        QPoint delta = event->pos() - m_lastDragPos;
+        m_lastDragPos = event->pos();
+        emit windowLevelDragged(delta.x(), delta.y());
         return;
     }
     QGraphicsView::mouseMoveEvent(event);
@@ -108,6 +256,7 @@ void ImageView::mouseMoveEvent(QMouseEvent* event) {
 void ImageView::mouseReleaseEvent(QMouseEvent* event) {
     if (m_drawingEnabled && event->button() == Qt::LeftButton && m_currentRect) {
         QRectF r = m_currentRect->rect();
+        emit roiChanged(m_baseItem->mapFromScene(r).boundingRect());
         emit roiFinished(r);
         // leave the rectangle on scene for now; user can Clear ROI
         m_currentRect = nullptr;
@@ -115,5 +264,13 @@ void ImageView::mouseReleaseEvent(QMouseEvent* event) {
         setCursor(Qt::ArrowCursor);
         return;
     }
+    if (m_crosshairDrag && event->button() == Qt::LeftButton) {
+        m_crosshairDrag = false;
+        return;
+    }
+    if (m_windowLevelDrag && event->button() == Qt::RightButton) {
+        m_windowLevelDrag = false;
+        return;
+    }
     QGraphicsView::mouseReleaseEvent(event);
 }
@@ -1,5 +1,15 @@
 #include "gui/main_window.h"
+#include "dicom/cine_player.h"
 #include "dicom/dicom_utils.h"
+#include "dicom/fusion.h"
+#include "dicom/mpr.h"
+#include "dicom/projection.h"
+#include "dicom/roi_stats.h"
+#include "dicom/series_loader.h"
+#include "dicom/trace.h"
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+#include "dicom/window_presets.h"
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QPushButton>
@@ -17,6 +27,15 @@
 #include <QStringList>
 #include <QDebug>
 #include <QComboBox>
+#include <QProgressBar>
+#include <QSignalBlocker>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSpinBox>
+#include <QPoint>
+#include <QDir>
+#include <QDateTime>
+#include <QFileSystemWatcher>
 
 #include <gdcmImageReader.h>
 #include <gdcmImage.h>
@@ -33,105 +52,146 @@
 #include <gdcmDict.h>
 #include <gdcmDictEntry.h>
 
+#include <algorithm>
+#include <cmath>
+#include <set>
 #include <optional>
+#include <utility>
 
-double getNumericTag(const gdcm::File& f,
-                     const gdcm::DataSet& ds,
-                     uint16_t group,
-                     uint16_t element,
-                     int index = 0) {
-    gdcm::Tag tag(group, element);
-    if (!ds.FindDataElement(tag)) return 0.0;
-
-    gdcm::DataElement de = ds.GetDataElement(tag);
-    gdcm::StringFilter sf;
-    sf.SetFile(f);
-
-    QString value = QString::fromStdString(sf.ToString(de));
-    // DICOM often uses \ to sepearate numbers
-    QStringList parts = value.split('\\');
-    if (index < parts.size()) {
-        auto p = parts[index];
-        bool ok = false;
-        auto result = parts[index].toDouble(&ok);
-        if (ok) return result;
-    }
-    return 0.0;
-}
-
-int windowCenter = 40;  // just guessing
-int windowWidth = 400;  // just guessing
-
-// Helper: convert GDCM imate to QImage (grayscale)
-static QImage gdcmImageToQImage(const gdcm::Image& gimg, int windowCenter, int windowWidth) {
-    const unsigned int* dims = gimg.GetDimensions();
-    int w = dims[0];
-    int h = dims[1];
-
-    gdcm::PixelFormat pf = gimg.GetPixelFormat();
-    int bits = pf.GetBitsAllocated();       // e.g. 16/8
-
-    std::vector<char> buffer(gimg.GetBufferLength());
-    gimg.GetBuffer(buffer.data());
-
-    QImage img(w, h, QImage::Format_Grayscale8);
-
-    if (bits == 8) {
-        // direct copy
-        const unsigned char* src = reinterpret_cast<unsigned char*>(buffer.data());
-        for (int y = 0; y < h; ++y) {
-            uchar* scan = img.scanLine(y);
-            memcpy(scan, src + y*w, w);
-        }
-    } else if (bits == 16) {
-        // rescale 16-git -> 8-bit
-        const uint16_t* src = reinterpret_cast<uint16_t*>(buffer.data());
-
-        uint16_t minVal = std::numeric_limits<uint16_t>::max();
-        uint16_t maxVal = std::numeric_limits<uint16_t>::min();
-        for (int i = 0; i < w*h; i++) {
-            if (src[i] < minVal) minVal = src[i];
-            if (src[i] > maxVal) maxVal = src[i];
-        }
-        
-        // if no WL specified -> auto fit
-        if (windowCenter < 0 || windowWidth < 0) {
-            windowCenter = (minVal + maxVal) / 2;
-            windowWidth = maxVal - minVal;
-        }
-
-        int wc = windowCenter;
-        int ww = windowWidth;
-
-        for (int y = 0; y < h; ++y) {
-            uchar* scan = img.scanLine(y);
-            for (int x = 0; x < w; ++x) {
-                int idx = y*w + x;
-                int p = src[idx];
-
-                int minWin = wc - ww/2;
-                int maxWin = wc + ww/2;
+static int slabLoadedSlices(const d3m::Volume& volume, int first, int last) {
+    int loaded = 0;
+    for (int z = first; z < last; ++z)
+        if (volume.isSliceLoaded(z)) ++loaded;
+    return loaded;
+}
 
-                if (p <= minWin)
-                    scan[x] = 0;
-                else if (p > maxWin)
-                    scan[x] = 255;
-                else
-                    scan[x] = (uchar)(((p - minWin) / (double)ww) * 255.0);
-            }
-        }
-    } else {
-        // unsupported format for now..
-        img.fill(Qt::black);
+// True once the histogram has counted every slice a background pass decodes;
+// a frame-cached volume only decodes as many frames as it keeps (see
+// SlicePrefetcher::requestAll)
+static bool histogramComplete(const d3m::Volume& volume) {
+    int target = volume.depth();
+    if (volume.isFrameCached()) {
+        const int reach = static_cast<int>(d3m::Volume::FrameCacheBudget / (volume.sliceSize() * sizeof(uint16_t)) / 2);
+        target = std::min(target, std::max(1, 2 * reach - 1));
     }
-
-    return img.flipped(Qt::Orientation::Vertical);
+    return volume.histogram().slices() >= target;
 }
 
 // ---------------- MainWindow implementation ----------------
 MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     m_view = new ImageView(this);
-    setCentralWidget(m_view);
+
+    // MPR page: the three planes side by side, sharing one crosshair
+    QWidget* mprWidget = new QWidget(this);
+    QHBoxLayout* mprLayout = new QHBoxLayout(mprWidget);
+    mprLayout->setContentsMargins(0,0,0,0);
+    for (std::size_t i = 0; i < mprViews.size(); ++i) {
+        const auto plane = static_cast<d3m::Plane>(i);
+        QVBoxLayout* pane = new QVBoxLayout;
+        mprTitles[i] = new QLabel(mprWidget);
+        mprTitles[i]->setAlignment(Qt::AlignCenter);
+        mprViews[i] = new ImageView(mprWidget);
+        mprViews[i]->setCrosshairEnabled(true);
+        pane->addWidget(mprTitles[i]);
+        pane->addWidget(mprViews[i], 1);
+        mprLayout->addLayout(pane);
+        connect(mprViews[i], &ImageView::crosshairMoved, this, [this, plane](const QPointF& pos) {
+            onMprCrosshair(plane, pos);
+        });
+        connect(mprViews[i], &ImageView::windowLevelDragged, this, [this](int dx, int dy) {
+            setWindowLevel(windowCenter + dy * 2, windowWidth + dx * 4);
+        });
+    }
+
+    viewStack = new QStackedWidget(this);
+    viewStack->addWidget(m_view);
+    viewStack->addWidget(mprWidget);
+    setCentralWidget(viewStack);
+
+    perfOverlay = new QLabel(viewStack);
+    perfOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    perfOverlay->setStyleSheet("QLabel { background: rgba(0,0,0,160); color: #9f9; font-family: monospace; padding: 4px; }");
+    perfOverlay->move(8, 8);
+    perfOverlay->hide();
+    perfTimer = new QTimer(this);
+    perfTimer->setInterval(500);
+    connect(perfTimer, &QTimer::timeout, this, &MainWindow::updatePerfOverlay);
+
+    cine = new d3m::CinePlayer(this);
+    connect(cine, &d3m::CinePlayer::frameReady, this, &MainWindow::showCineFrame);
+
+    // redraw the reformatted planes while the rest of the volume decodes
+    mprRefresh = new QTimer(this);
+    mprRefresh->setInterval(100);
+    connect(mprRefresh, &QTimer::timeout, this, [this]() {
+        auto volume = mprMode ? volumeFor(currentSeriesUID) : nullptr;
+        if (!volume) {
+            mprRefresh->stop();
+            return;
+        }
+        if (volume->loadedSlices() != mprLoadedShown)
+            updateMprViews();
+        if (volume->loadedSlices() == volume->depth())
+            mprRefresh->stop();
+    });
+
+    // redraw an axial slab while its slices decode
+    slabRefresh = new QTimer(this);
+    slabRefresh->setInterval(100);
+    connect(slabRefresh, &QTimer::timeout, this, [this]() {
+        auto* cached = projectionMode && !mprMode ? volumeCache.find(currentSeriesUID) : nullptr;
+        if (!cached) {
+            slabRefresh->stop();
+            return;
+        }
+        int first = 0, last = 0;
+        d3m::slabRange(**cached, d3m::Plane::Axial, currentSlice, slabThickness, first, last);
+        const int loaded = slabLoadedSlices(**cached, first, last);
+        if (loaded != slabLoadedShown)
+            renderCurrentSlice();
+        if (loaded == last - first)
+            slabRefresh->stop();
+    });
+
+    // decode the rest of a series whose Auto window came from part of it,
+    // then apply Auto again, unless another window was picked meanwhile
+    autoRefresh = new QTimer(this);
+    autoRefresh->setInterval(250);
+    connect(autoRefresh, &QTimer::timeout, this, [this]() {
+        auto* cached = volumeCache.find(currentSeriesUID);
+        if (!cached || windowCombo->currentIndex() != 0 || autoShown != QPoint(windowCenter, windowWidth)) {
+            autoRefresh->stop();
+            return;
+        }
+        if (histogramComplete(**cached)) {
+            autoRefresh->stop();
+            applyWindowPreset(0);
+            return;
+        }
+        // again after the view asked for other slices
+        if (!autoRequested) {
+            prefetcher.requestAll(*cached, currentSlice);
+            autoRequested = true;
+        }
+    });
+
+    // measure a 3D ROI again while its slab decodes
+    roiRefresh = new QTimer(this);
+    roiRefresh->setInterval(100);
+    connect(roiRefresh, &QTimer::timeout, this, [this]() {
+        auto* cached = roiRect && roi3dToggle->isChecked() && !mprMode ? volumeCache.find(currentSeriesUID) : nullptr;
+        if (!cached) {
+            roiRefresh->stop();
+            return;
+        }
+        int first = 0, last = 0;
+        d3m::slabRange(**cached, d3m::Plane::Axial, currentSlice, slabThickness, first, last);
+        const int loaded = slabLoadedSlices(**cached, first, last);
+        if (loaded != roiSlicesShown)
+            updateRoiStats();
+        if (loaded == last - first)
+            roiRefresh->stop();
+    });
 
     auto toolWidget = createToolBarWidget();
     QToolBar* toolbar = new QToolBar(this);
@@ -142,17 +202,35 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     metaFilter = new QLineEdit();
     metaFilter->setPlaceholderText("Search DICOM tags...");
 
-    // Tree widget
-    metaTree = new QTreeWidget();
-    metaTree->setColumnCount(2);
-    metaTree->setHeaderLabels(QStringList() << "Tag" << "Value" << "VR");
+    // Tag table, backed by the tag store parsed at load time
+    metaModel = new MetadataModel(this);
+    metaView = new QTreeView();
+    metaView->setModel(metaModel);
+    metaView->setRootIsDecorated(false);
+    metaView->setUniformRowHeights(true);
+
+    // Matches across all slices and series
+    searchStatus = new QLabel();
+    searchResults = new QListWidget();
+    searchResults->setUniformItemSizes(true);
 
     // Layout inside dock
     QWidget* metaWidget = new QWidget();
     QVBoxLayout* vbox = new QVBoxLayout(metaWidget);
     vbox->setContentsMargins(2,2,2,2);
     vbox->addWidget(metaFilter);
-    vbox->addWidget(metaTree);
+    vbox->addWidget(metaView, 3);
+    vbox->addWidget(searchStatus);
+    vbox->addWidget(searchResults, 1);
+    roiLabel = new QLabel();
+    roiLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    roiHistogram = new HistogramWidget();
+    vbox->addWidget(roiLabel);
+    vbox->addWidget(roiHistogram);
+    seriesHistogram = new HistogramWidget();
+    seriesHistogram->setToolTip("Series histogram (decoded slices), current window shaded");
+    vbox->addWidget(new QLabel("Series histogram"));
+    vbox->addWidget(seriesHistogram);
 
     // Vertical Dock
     QDockWidget* dock = new QDockWidget("DICOM Metadata", this);
@@ -164,13 +242,68 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     toolbar->addWidget(seriesCombo);
 
     connect(metaFilter, &QLineEdit::textChanged, this, &MainWindow::filterMetadata);
+    connect(searchResults, &QListWidget::itemActivated, this, [this](QListWidgetItem* item) {
+        if (!searchIndex) return;
+        const auto& doc = searchIndex->document(item->data(Qt::UserRole).toInt());
+        const int comboIndex = seriesCombo->findData(searchIndex->seriesKey(doc.series));
+        if (comboIndex < 0) return;
+        seriesCombo->setCurrentIndex(comboIndex);
+        showSlice(doc.slices.front());
+    });
     connect(m_view, &ImageView::roiFinished, this, &MainWindow::onROIFinished);
+    connect(m_view, &ImageView::roiChanged, this, [this](const QRectF& rect) {
+        roiRect = rect;
+        updateRoiStats();
+    });
+    connect(m_view, &ImageView::windowLevelDragged, this, [this](int dx, int dy) {
+        // horizontal drag = width, vertical drag = center
+        setWindowLevel(windowCenter + dy * 2, windowWidth + dx * 4);
+    });
     connect(seriesCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index){
         if (index < 0) return;
         QString uid = seriesCombo->itemData(index).toString();
+        cineBtn->setChecked(false);
         currentSeriesUID = uid;
         currentSlice = 0;
+        lastShownSlice = -1;
+        histogramShown = -1;
+        // the file's own window if it has one, else auto once the first slice is decoded
+        const bool tagged = populateWindowPresets();
+        if (tagged) applyWindowPreset(1);
+        if (mprMode) startMpr();
         showSlice(currentSlice);
+        if (!tagged) applyWindowPreset(0);
+    });
+
+    // Background series loading, progress + cancel live in the status bar
+    seriesLoader = new d3m::SeriesLoader(this);
+    loadProgress = new QProgressBar(this);
+    loadProgress->setMaximumWidth(200);
+    loadProgress->setVisible(false);
+    cancelLoadBtn = new QPushButton("Cancel", this);
+    cancelLoadBtn->setVisible(false);
+    statusBar()->addPermanentWidget(loadProgress);
+    statusBar()->addPermanentWidget(cancelLoadBtn);
+
+    connect(seriesLoader, &d3m::SeriesLoader::progress, this, &MainWindow::onSeriesLoadProgress);
+    connect(seriesLoader, &d3m::SeriesLoader::seriesFound, this, &MainWindow::onSeriesFound);
+    connect(seriesLoader, &d3m::SeriesLoader::finished, this, &MainWindow::onSeriesLoaded);
+    connect(seriesLoader, &d3m::SeriesLoader::cancelled, this, &MainWindow::onSeriesLoadCancelled);
+    connect(cancelLoadBtn, &QPushButton::clicked, seriesLoader, &d3m::SeriesLoader::cancel);
+
+    // files still arriving in the loaded folder; picked up once they settle
+    folderWatcher = new QFileSystemWatcher(this);
+    watchTimer = new QTimer(this);
+    watchTimer->setSingleShot(true);
+    watchTimer->setInterval(WatchSettleMs);
+    connect(folderWatcher, &QFileSystemWatcher::directoryChanged, watchTimer, QOverload<>::of(&QTimer::start));
+    connect(watchTimer, &QTimer::timeout, this, &MainWindow::scanWatchedFolder);
+    connect(watchToggle, &QCheckBox::toggled, this, [this](bool on) {
+        if (!folderWatcher->directories().isEmpty()) folderWatcher->removePaths(folderWatcher->directories());
+        if (on && !loadedFolder.isEmpty()) {
+            folderWatcher->addPath(loadedFolder);
+            watchTimer->start();
+        }
     });
 
     statusBar()->showMessage("Ready");
@@ -189,21 +322,63 @@ QWidget* MainWindow::createToolBarWidget() {
     opacitySlider->setValue(60);
     QCheckBox* overlayToggle = new QCheckBox("Show Overlay");
     overlayToggle->setChecked(true);
+    fusionCombo = new QComboBox;
+    fusionCombo->setToolTip("Fuse another series of the folder over this one, resampled into its geometry");
+    fusionCombo->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+    fusionCombo->addItem("No fusion");
+    colormapCombo = new QComboBox;
+    colormapCombo->addItem("Hot", static_cast<int>(d3m::Colormap::Hot));
+    colormapCombo->addItem("Rainbow", static_cast<int>(d3m::Colormap::Rainbow));
+    colormapCombo->addItem("Gray", static_cast<int>(d3m::Colormap::Gray));
 
     QPushButton* drawRoiBtn = new QPushButton("Draw ROI");
     QPushButton* clearRoiBtn = new QPushButton("Clear ROI");
+    roi3dToggle = new QCheckBox("3D ROI");
+    roi3dToggle->setToolTip("Measure the ROI through the slab thickness, not just the current slice");
 
     QPushButton* loadDicomBtn = new QPushButton("Load DICOM");
     QPushButton* loadSeriesBtn = new QPushButton("Load DICOM Series");
+    watchToggle = new QCheckBox("Watch");
+    watchToggle->setToolTip("Keep loading files that arrive in the folder, e.g. while a modality is still sending");
     QPushButton* prevBtn = new QPushButton("Prev");
     QPushButton* nextBtn = new QPushButton("Next");
-
-    // QSlider* wcSlider = new QSlider(Qt::Horizontal);
-    // wcSlider->setRange(-1000, 3000);
-    // wcSlider->setValue(windowCenter);
-    // QSlider* wwSlider = new QSlider(Qt::Horizontal);
-    // wwSlider->setRange(1, 4000);
-    // wwSlider->setValue(windowWidth);
+    mprToggle = new QCheckBox("MPR");
+
+    projectionCombo = new QComboBox;
+    projectionCombo->addItem("Slice");
+    projectionCombo->addItem("MIP", QVariant::fromValue(static_cast<int>(d3m::ProjectionMode::Mip)));
+    projectionCombo->addItem("MinIP", QVariant::fromValue(static_cast<int>(d3m::ProjectionMode::MinIp)));
+    projectionCombo->addItem("Average", QVariant::fromValue(static_cast<int>(d3m::ProjectionMode::Average)));
+    slabSpin = new QSpinBox;
+    slabSpin->setRange(1, 2000);
+    slabSpin->setValue(slabThickness);
+    slabSpin->setToolTip("Slab thickness (slices)");
+
+    cineBtn = new QPushButton("Play");
+    cineBtn->setCheckable(true);
+    cineBtn->setToolTip("Cine: play the series in a loop");
+    fpsSpin = new QSpinBox;
+    fpsSpin->setRange(1, d3m::CinePlayer::MaxFps);
+    fpsSpin->setValue(15);
+    fpsSpin->setSuffix(" fps");
+
+    windowCombo = new QComboBox;
+    windowCombo->setToolTip("Window presets: auto from the series histogram (refined once the whole series "
+                             "has decoded), the file's own, modality presets");
+    windowCombo->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+
+    QCheckBox* perfToggle = new QCheckBox("Perf");
+    perfToggle->setToolTip("Show timings of the last 10 s over the image");
+    QPushButton* exportTraceBtn = new QPushButton("Export Trace");
+
+    wcSlider = new QSlider(Qt::Horizontal);
+    wcSlider->setRange(-1000, 3000);
+    wcSlider->setValue(windowCenter);
+    wcSlider->setToolTip("Window center");
+    wwSlider = new QSlider(Qt::Horizontal);
+    wwSlider->setRange(1, 4000);
+    wwSlider->setValue(windowWidth);
+    wwSlider->setToolTip("Window width");
 
     sliceSlider = new QSlider(Qt::Horizontal);
     sliceSlider->setRange(0,0);
@@ -214,14 +389,26 @@ QWidget* MainWindow::createToolBarWidget() {
     h->addWidget(opacityLabel);
     h->addWidget(opacitySlider);
     h->addWidget(overlayToggle);
+    h->addWidget(fusionCombo);
+    h->addWidget(colormapCombo);
     h->addWidget(drawRoiBtn);
     h->addWidget(clearRoiBtn);
+    h->addWidget(roi3dToggle);
     h->addWidget(loadDicomBtn);
     h->addWidget(loadSeriesBtn);
+    h->addWidget(watchToggle);
     h->addWidget(prevBtn);
     h->addWidget(nextBtn);
-    // h->addWidget(wcSlider);
-    // h->addWidget(wwSlider);
+    h->addWidget(cineBtn);
+    h->addWidget(fpsSpin);
+    h->addWidget(mprToggle);
+    h->addWidget(projectionCombo);
+    h->addWidget(slabSpin);
+    h->addWidget(perfToggle);
+    h->addWidget(exportTraceBtn);
+    h->addWidget(windowCombo);
+    h->addWidget(wcSlider);
+    h->addWidget(wwSlider);
     h->addWidget(sliceSlider);
     h->addStretch();
 
@@ -229,107 +416,308 @@ QWidget* MainWindow::createToolBarWidget() {
     connect(loadOverlayBtn, &QPushButton::clicked, this, &MainWindow::onLoadOverlay);
     connect(opacitySlider, &QSlider::valueChanged, this, &MainWindow::onOpacityChanged);
     connect(overlayToggle, &QCheckBox::toggled, this, &MainWindow::onToggleOverlay);
+    connect(fusionCombo, QOverload<int>::of(&QComboBox::activated), this, &MainWindow::setFusionSeries);
+    connect(colormapCombo, QOverload<int>::of(&QComboBox::activated), this, [this] {
+        if (fusing()) renderCurrentSlice();
+    });
     connect(drawRoiBtn, &QPushButton::clicked, this, &MainWindow::onStartDrawROI);
     connect(clearRoiBtn, &QPushButton::clicked, this, &MainWindow::onClearROI);
+    connect(roi3dToggle, &QCheckBox::toggled, this, [this] { updateRoiStats(); });
     connect(loadDicomBtn, &QPushButton::clicked, this, &MainWindow::onLoadDicom);
     connect(loadSeriesBtn, &QPushButton::clicked, this, &MainWindow::onLoadDicomSeries);
     connect(nextBtn, &QPushButton::clicked, this, &MainWindow::onNextSlice);
     connect(prevBtn, &QPushButton::clicked, this, &MainWindow::onPrevSlice);
-    // connect(wcSlider, &QSlider::valueChanged, this, [=](int v){windowCenter = v; showSlice(currentSlice);});
-    // connect(wwSlider, &QSlider::valueChanged, this, [=](int v) {windowWidth = v; showSlice(currentSlice);});
+    connect(mprToggle, &QCheckBox::toggled, this, &MainWindow::onToggleMpr);
+    connect(cineBtn, &QPushButton::toggled, this, &MainWindow::onToggleCine);
+    connect(fpsSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int v) { cine->setFps(v); });
+    connect(perfToggle, &QCheckBox::toggled, this, &MainWindow::onTogglePerfOverlay);
+    connect(exportTraceBtn, &QPushButton::clicked, this, &MainWindow::onExportTrace);
+    connect(projectionCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index) {
+        const QVariant mode = projectionCombo->itemData(index);
+        if (mode.isValid()) projectionMode = static_cast<d3m::ProjectionMode>(mode.toInt());
+        else projectionMode.reset();
+        renderCurrentSlice();
+    });
+    connect(slabSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int v) {
+        slabThickness = v;
+        if (projectionMode) renderCurrentSlice();
+    });
+    connect(windowCombo, QOverload<int>::of(&QComboBox::activated), this, &MainWindow::applyWindowPreset);
+    connect(wcSlider, &QSlider::valueChanged, this, [this](int v) {setWindowLevel(v, windowWidth);});
+    connect(wwSlider, &QSlider::valueChanged, this, [this](int v) {setWindowLevel(windowCenter, v);});
     connect(sliceSlider, &QSlider::valueChanged, this, [this](int v) {showSlice(v);});
 
     return w;
 }
 
+// Every file of a series folder, as absolute paths
+static QStringList folderFiles(const QString& dirPath) {
+    QDir dir(dirPath);
+    QStringList filters;
+    filters << "*.dcm" << "*.dicom" << "*";
+    QStringList fullPaths;
+    for (const QString& f : dir.entryList(filters, QDir::Files))
+        fullPaths << dir.absoluteFilePath(f);
+    return fullPaths;
+}
+
+static QPair<qint64, qint64> fileStamp(const QFileInfo& info) {
+    return {info.size(), info.lastModified().toMSecsSinceEpoch()};
+}
+
 void MainWindow::onLoadDicomSeries() {
     // QString dirPath = QFileDialog::getExistingDirectory(this, "Select DICOM Series Folder");
     auto dirPath = QString("/Users/greg/repo/mri/gk/");
     if (dirPath.isEmpty()) return;
 
-    QDir dir(dirPath);
-    QStringList filters;
-    filters << "*.dcm" << "*.dicom" << "*";
-    QStringList files = dir.entryList(filters, QDir::Files);
-    if (files.isEmpty()) return;
-
+    QStringList fullPaths = folderFiles(dirPath);
+    if (fullPaths.isEmpty()) return;
+
+    // a new folder: everything of the old one goes, the new one fills in as it
+    // is scanned; the old scan is stopped even if none of the new files is ready
+    seriesLoader->cancel();
+    loadProgress->setVisible(false);
+    cancelLoadBtn->setVisible(false);
+    prefetcher.cancel();
+    cineBtn->setChecked(false);
+    volumeCache.clear();
+    pixmapCache.clear();
     seriesMap.clear();
-
-    for (const QString& f : files) {
-        QString fullPath = dir.absoluteFilePath(f);
-
-        gdcm::ImageReader r;
-        r.SetFileName(fullPath.toStdString().c_str());
-        if (!r.Read()) continue;
-
-        gdcm::Image& gimg = r.GetImage();
-        QImage qimg = gdcmImageToQImage(gimg, windowCenter, windowWidth);
-
-        const gdcm::File& file = r.GetFile();
-        const gdcm::DataSet& ds = file.GetDataSet();
-
-        d3m::SliceInfo slice;
-        slice.image      = qimg;
-        slice.filePath   = fullPath;
-        slice.instanceNumber = (int)getNumericTag(file, ds, d3m::InstanceNumber.group, d3m::InstanceNumber.element);
-        slice.pixelSpacingX  = getNumericTag(file, ds, d3m::PixelSpacing.group, d3m::PixelSpacing.element, 0);
-        slice.pixelSpacingY  = getNumericTag(file, ds, d3m::PixelSpacing.group, d3m::PixelSpacing.element, 1);
-        slice.sliceThickness = getNumericTag(file, ds, d3m::SliceThickness.group, d3m::SliceThickness.element);
-        slice.imagePosX      = getNumericTag(file, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 0);
-        slice.imagePosY      = getNumericTag(file, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 1);
-        slice.imagePosZ      = getNumericTag(file, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 2);
-        slice.rowCosX        = getNumericTag(file, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 0);
-        slice.rowCosY        = getNumericTag(file, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 1);
-        slice.rowCosZ        = getNumericTag(file, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 2);
-        slice.colCosX        = getNumericTag(file, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 3);
-        slice.colCosY        = getNumericTag(file, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 4);
-        slice.colCosZ        = getNumericTag(file, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 5);
-
-        slice.sliceLocation = slice.imagePosZ; // fallback if instanceNumber missing
-
-        // Series UID
-        gdcm::Tag seriesUIDTag(d3m::SeriesInstanceUID.group, d3m::SeriesInstanceUID.element);
-        if (ds.FindDataElement(seriesUIDTag)) {
-            gdcm::DataElement de = ds.GetDataElement(seriesUIDTag);
-            gdcm::StringFilter sf;
-            sf.SetFile(file);
-            slice.seriesUID = QString::fromStdString(sf.ToString(de));
+    searchIndex.reset();
+    lastShownSlice = -1;
+    fusionSeriesUID.clear();
+    fusionVolume.reset();
+    seriesCombo->clear();
+    fusionCombo->clear();
+    fusionCombo->addItem("No fusion");
+
+    loadedFolder = QDir(dirPath).absolutePath();
+    if (!folderWatcher->directories().isEmpty()) folderWatcher->removePaths(folderWatcher->directories());
+    if (watchToggle->isChecked()) folderWatcher->addPath(loadedFolder);
+
+    // files still being written are left to a later pass, like watched ones
+    const QDateTime settled = QDateTime::currentDateTime().addMSecs(-WatchSettleMs);
+    QStringList ready;
+    knownFiles.clear();
+    changedFiles.clear();
+    settlePending = false;
+    for (const QString& path : fullPaths) {
+        const QFileInfo info(path);
+        if (info.lastModified() > settled) {
+            settlePending = true;
+            continue;
         }
+        knownFiles.insert(path, fileStamp(info));
+        ready << path;
+    }
+    if (settlePending) watchTimer->start();
+    if (ready.isEmpty()) return;
+
+    loadProgress->setRange(0, static_cast<int>(ready.size()));
+    loadProgress->setValue(0);
+    loadProgress->setVisible(true);
+    cancelLoadBtn->setVisible(true);
+    statusBar()->showMessage(QString("Loading %1 files...").arg(ready.size()));
+
+    seriesLoader->start(ready);
+}
+
+void MainWindow::onSeriesLoadProgress(int done, int total) {
+    loadProgress->setRange(0, total);
+    loadProgress->setValue(done);
+}
+
+void MainWindow::onSeriesLoaded() {
+    auto result = seriesLoader->takeResult();
+    if (!result) return; // stale signal from a superseded run
+
+    loadProgress->setVisible(false);
+    cancelLoadBtn->setVisible(false);
+
+    // the whole result, and stacks that went away; the stacks shown while
+    // scanning stay, only ones that still changed are rebuilt
+    d3m::StackUpdates updates;
+    for (const auto& kv : seriesMap) {
+        if (!result->count(kv.first)) updates[kv.first].reset = true;
+    }
+    for (auto& [key, stack] : *result) {
+        d3m::StackUpdate& update = updates[key];
+        update.reset = true;
+        update.slices = std::move(stack);
+    }
+    mergeSeries(std::move(updates));
+    changedFiles.clear();
+    searchIndex = seriesLoader->takeSearchIndex();
+    filterMetadata(metaFilter->text());
+    statusBar()->showMessage(QString("Loaded %1 series (%2 files parsed, rest from index)")
+        .arg(seriesMap.size()).arg(seriesLoader->scannedFiles()));
+}
+
+void MainWindow::onSeriesFound() {
+    mergeSeries(seriesLoader->takeUpdates());
+}
 
-        // Series Description (optional)
-        gdcm::Tag seriesDescTag(d3m::SeriesDesc.group, d3m::SeriesDesc.element);
-        if (ds.FindDataElement(seriesDescTag)) {
-            gdcm::DataElement de = ds.GetDataElement(seriesDescTag);
-            gdcm::StringFilter sf;
-            sf.SetFile(file);
-            slice.seriesDesc = QString::fromStdString(sf.ToString(de));
+// Takes stack updates into seriesMap. New series are added to the pickers
+// (the first one is shown right away). A stack that only got slices grows
+// in place, its volume too, so nothing decoded moves; stacks that were
+// split or reordered are rebuilt around the slices they already decoded
+// (except those of files rewritten since), and ones that went away are
+// dropped. The view stays on the slice it was showing.
+void MainWindow::mergeSeries(d3m::StackUpdates&& updates) {
+    if (updates.empty()) return;
+
+    std::optional<std::pair<QString, int>> shown;
+    auto current = seriesMap.find(currentSeriesUID);
+    if (current != seriesMap.end() && currentSlice < static_cast<int>(current->second.size()))
+        shown = std::make_pair(current->second[currentSlice].filePath, current->second[currentSlice].frameIndex);
+
+    const auto sameSlices = [](const std::vector<d3m::SliceInfo>& a, const std::vector<d3m::SliceInfo>& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const d3m::SliceInfo& x, const d3m::SliceInfo& y) {
+            return x.filePath == y.filePath && x.frameIndex == y.frameIndex;
+        });
+    };
+    const auto rebuild = [this](const QString& key) {
+        if (!volumeCache.contains(key)) return;
+        auto previous = *volumeCache.find(key);
+        auto volume = std::make_shared<d3m::Volume>(seriesMap[key]);
+        volume->adoptSlices(*previous, changedFiles);
+        volumeCache.insert(key, volume, volume->maxResidentBytes());
+    };
+
+    bool changed = false, currentChanged = false, currentReset = false;
+    for (auto& [key, update] : updates) {
+        auto it = seriesMap.find(key);
+        const bool added = it == seriesMap.end();
+        if (update.reset && update.slices.empty()) {
+            // a sub-series the series no longer has, e.g. split into phases since
+            if (added) continue;
+            seriesMap.erase(it);
+            volumeCache.erase(key);
+            changed = true;
+            if (key == fusionSeriesUID) {
+                fusionSeriesUID.clear();
+                fusionVolume.reset();
+            }
+            fusionCombo->removeItem(fusionCombo->findData(key));
+            // removing the current one moves the combo, which shows its new pick
+            seriesCombo->removeItem(seriesCombo->findData(key));
+            continue;
+        }
+        if (added) {
+            auto& stack = seriesMap[key];
+            d3m::applyStackUpdate(stack, std::move(update));
+            const d3m::SliceInfo& first = stack.front();
+            const QString desc = first.seriesDesc.isEmpty() ? key : first.seriesDesc;
+            fusionCombo->addItem(desc, key);
+            seriesCombo->addItem(desc, key);
+            continue;
         }
 
-        if (!slice.seriesUID.isEmpty()) {
-            seriesMap[slice.seriesUID].push_back(slice);
+        if (update.reset) {
+            const bool rewritten = std::any_of(update.slices.begin(), update.slices.end(), [this](const d3m::SliceInfo& s) {
+                return changedFiles.count(s.filePath) > 0;
+            });
+            if (!rewritten && sameSlices(it->second, update.slices)) {
+                it->second = std::move(update.slices); // tags may have been interned since
+                continue;
+            }
+            it->second = std::move(update.slices);
+            rebuild(key);
+            if (key == currentSeriesUID) currentReset = true;
+        } else {
+            // grows in place; a volume that cannot take the new slices is rebuilt
+            auto* cached = volumeCache.find(key);
+            const bool grown = cached && (*cached)->insertSlices(update.positions, update.slices);
+            d3m::applyStackUpdate(it->second, std::move(update));
+            if (grown) volumeCache.insert(key, *cached, (*cached)->maxResidentBytes());
+            else rebuild(key);
         }
+        changed = true;
+        if (key == fusionSeriesUID) fusionVolume = volumeFor(key);
+        if (key == currentSeriesUID) currentChanged = true;
     }
+    // cached pixmaps are keyed by slice index, which may have moved
+    if (changed) pixmapCache.clear();
+    if (!currentChanged || !seriesMap.count(currentSeriesUID)) return;
+
+    cineBtn->setChecked(false);
+    prefetcher.cancel();
+    const auto& stack = seriesMap[currentSeriesUID];
+    int index = currentSlice;
+    for (int i = 0; shown && i < static_cast<int>(stack.size()); ++i) {
+        if (stack[i].filePath == shown->first && stack[i].frameIndex == shown->second) {
+            index = i;
+            break;
+        }
+    }
+    // a grown stack keeps ROIs and zoom; a rebuilt one starts over
+    if (currentReset) {
+        lastShownSlice = -1;
+        histogramShown = -1;
+    } else {
+        lastShownSlice = index;
+        currentGeometry = d3m::analyzeStack(stack);
+    }
+    if (mprMode) {
+        currentSlice = index;
+        startMpr();
+    }
+    showSlice(index);
+}
 
-    // Sort slices inside each series
-    for (auto& kv : seriesMap) {
-        auto& stack = kv.second;
-        std::sort(stack.begin(), stack.end(), [](const d3m::SliceInfo& a, const d3m::SliceInfo& b) {
-            if (a.instanceNumber > 0 && b.instanceNumber > 0)
-                return a.instanceNumber < b.instanceNumber;
-            return a.sliceLocation < b.sliceLocation;
-        });
+// New and rewritten files of the loaded folder, once they have stopped
+// changing; one still being written is picked up on a later pass. Runs
+// while the folder is watched, and without watching until the files of the
+// initial listing have settled.
+void MainWindow::scanWatchedFolder() {
+    if (loadedFolder.isEmpty() || (!watchToggle->isChecked() && !settlePending)) return;
+    if (seriesLoader->isRunning()) {
+        watchTimer->start();
+        return;
     }
 
-    // Populate combo box
-    seriesCombo->clear();
-    for (const auto& kv : seriesMap) {
-        QString uid = kv.first;
-        QString desc = kv.second.front().seriesDesc.isEmpty() ? uid : kv.second.front().seriesDesc;
-        seriesCombo->addItem(desc, uid);
+    const QDateTime settled = QDateTime::currentDateTime().addMSecs(-WatchSettleMs);
+    QStringList arrived;
+    std::vector<QPair<qint64, qint64>> stamps;
+    bool settling = false;
+    for (const QString& path : folderFiles(loadedFolder)) {
+        const QFileInfo info(path);
+        const auto stamp = fileStamp(info);
+        const auto known = knownFiles.constFind(path);
+        if (known != knownFiles.constEnd() && *known == stamp) continue;
+        if (info.lastModified() > settled) {
+            settling = true;
+            continue;
+        }
+        if (known != knownFiles.constEnd()) changedFiles.insert(path);
+        arrived << path;
+        stamps.push_back(stamp);
     }
+    settlePending = settling;
+    if (settling) watchTimer->start();
+    if (arrived.isEmpty()) return;
+    // nothing of the folder was ready when it was opened: this is the first run
+    if (knownFiles.isEmpty()) seriesLoader->start(arrived);
+    else if (!seriesLoader->append(arrived)) return;
+
+    for (int i = 0; i < arrived.size(); ++i) knownFiles.insert(arrived[i], stamps[i]);
+    loadProgress->setRange(0, static_cast<int>(arrived.size()));
+    loadProgress->setValue(0);
+    loadProgress->setVisible(true);
+    cancelLoadBtn->setVisible(true);
+    statusBar()->showMessage(QString("Loading %1 new files...").arg(arrived.size()));
+}
+
+void MainWindow::onSeriesLoadCancelled() {
+    if (seriesLoader->isRunning()) return; // a new run already started
+
+    loadProgress->setVisible(false);
+    cancelLoadBtn->setVisible(false);
+    statusBar()->showMessage("Loading cancelled");
 }
 
 bool MainWindow::showSlice(int index) {
+    D3M_TRACE_SCOPE("frame.slice");
     auto it = seriesMap.find(currentSeriesUID);
     if (it == seriesMap.end()) return false;
     const auto& stack = it->second;
@@ -340,21 +728,457 @@ bool MainWindow::showSlice(int index) {
     if (index > maxIndex) index = maxIndex;
     currentSlice = index;
 
-    sliceSlider->setRange(0, maxIndex);
-    sliceSlider->setValue(index);
+    {
+        // already showing it; don't come back through valueChanged
+        QSignalBlocker blocker(sliceSlider);
+        sliceSlider->setRange(0, maxIndex);
+        sliceSlider->setValue(index);
+    }
 
+    // pixels are decoded lazily into the series volume, the first time a slice is shown
     const d3m::SliceInfo& slice = stack[index];
-    m_view->loadBaseImage(slice.image);
-    m_view->fitInView(m_view->scene()->sceneRect(), Qt::KeepAspectRatio);
+    auto volume = volumeFor(currentSeriesUID);
+    if (!volume) return false;
+
+    // in MPR mode the slider moves the axial plane
+    if (mprMode) {
+        mprCursor.z = index;
+        updateMprViews();
+        metaModel->setTags(slice.tags);
+        applyMetadataFilter();
+        return true;
+    }
 
-    loadDicomMetadata(slice.filePath);
+    // rendered pixmaps are only valid for the LUT they were rendered with
+    if (windowLut.update(*volume, windowCenter, windowWidth))
+        pixmapCache.clear();
+
+    // decode ahead in the direction the user is scrolling; for compressed
+    // series the neighbours decode while this thread decodes the current slice
+    const int direction = lastShownSlice < 0 ? 0 : (index > lastShownSlice ? 1 : (index < lastShownSlice ? -1 : 0));
+    // a new (or rebuilt) stack starts over: ROIs, overlay and zoom belonged
+    // to the old one; stepping within a stack keeps them
+    const bool newStack = lastShownSlice < 0;
+    if (newStack) {
+        currentGeometry = d3m::analyzeStack(stack);
+        roiRect.reset();
+    }
+    lastShownSlice = index;
+    // a slab requests its own slices
+    if (volume->isCompressed() && !projectionMode) prefetcher.request(volume, index, direction);
+
+    const auto key = std::make_pair(currentSeriesUID, index);
+    QPixmap pixmap;
+    if (ImageView::wantsTiles(QSize(volume->width(), volume->height()))) {
+        // large images go to the view as tiles, never as one whole pixmap
+        if (!projectionMode && !volume->loadSlice(index)) {
+            statusBar()->showMessage("Failed to decode " + slice.filePath);
+            return false;
+        }
+        D3M_TRACE_SCOPE("scene");
+        QImage image = renderPlaneImage(*volume, d3m::Plane::Axial, index);
+        if (newStack) m_view->loadBaseImage(image);
+        else m_view->updateBaseImage(image);
+    } else if (projectionMode) {
+        // slabs depend on the thickness too, they are not cached
+        QImage image = renderPlaneImage(*volume, d3m::Plane::Axial, index);
+        D3M_TRACE_SCOPE("pixmap");
+        pixmap = QPixmap::fromImage(std::move(image));
+    } else if (const QPixmap* cached = fusing() ? nullptr : pixmapCache.find(key)) {
+        pixmap = *cached;
+    } else {
+        if (!volume->loadSlice(index)) {
+            statusBar()->showMessage("Failed to decode " + slice.filePath);
+            return false;
+        }
+        // fused slices also depend on the overlay, they are not cached
+        QImage image = fusing() ? renderPlaneImage(*volume, d3m::Plane::Axial, index)
+                                : d3m::renderSlice(*volume, index, windowLut);
+        D3M_TRACE_SCOPE("pixmap");
+        pixmap = QPixmap::fromImage(std::move(image));
+        if (!fusing())
+            pixmapCache.insert(key, pixmap, static_cast<std::size_t>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8);
+    }
+    if (!pixmap.isNull()) {
+        D3M_TRACE_SCOPE("scene");
+        // zoom, pan, overlay and ROIs carry over from the previous slice
+        if (newStack) m_view->loadBaseImage(pixmap);
+        else m_view->updateBaseImage(pixmap);
+    }
 
-    statusBar()->showMessage(QString("Series: %1 | Slice %2 / %3")
+    if (!volume->isCompressed() && !projectionMode) prefetcher.request(volume, index, direction);
+
+    metaModel->setTags(slice.tags);
+    applyMetadataFilter();
+    // the prefetch above replaced any earlier 3D ROI or Auto request
+    roiRequested = {-1, -1};
+    autoRequested = false;
+    if (roiRect || newStack) updateRoiStats();
+    if (volume->loadedSlices() != histogramShown) updateSeriesHistogram(*volume);
+
+    QString spacing;
+    if (currentGeometry.gaps > 0)
+        spacing = QString(" | %1 gap(s) in %2 mm spacing").arg(currentGeometry.gaps).arg(currentGeometry.spacing, 0, 'f', 2);
+    else if (!currentGeometry.uniform)
+        spacing = QString(" | uneven spacing %1-%2 mm").arg(currentGeometry.minSpacing, 0, 'f', 2).arg(currentGeometry.maxSpacing, 0, 'f', 2);
+    if (currentGeometry.duplicates > 0)
+        spacing += QString(" | %1 duplicate position(s)").arg(currentGeometry.duplicates);
+    statusBar()->showMessage(QString("Series: %1 | Slice %2 / %3 | Cache hit %4% (%5 MB)%6")
         .arg(slice.seriesDesc.isEmpty() ? "Unknown" : slice.seriesDesc)
-        .arg(index+1).arg(stack.size()));
+        .arg(index+1).arg(stack.size())
+        .arg(qRound(pixmapCache.hitRate() * 100.0))
+        .arg((pixmapCache.bytes() + volumeCache.bytes()) >> 20)
+        .arg(spacing));
     return true;
 }
 
+std::shared_ptr<d3m::Volume> MainWindow::volumeFor(const QString& seriesUID) {
+    if (auto* cached = volumeCache.find(seriesUID)) return *cached;
+
+    auto series = seriesMap.find(seriesUID);
+    if (series == seriesMap.end() || series->second.empty()) return nullptr;
+
+    // allocated on first use; series that are never viewed cost nothing
+    auto volume = std::make_shared<d3m::Volume>(series->second);
+    volumeCache.insert(seriesUID, volume, volume->maxResidentBytes());
+    return volume;
+}
+
+// The sliders only show the window; a window past their range is kept
+// as asked for, the slider just stops at its end
+void MainWindow::setWindowLevel(int center, int width) {
+    width = std::max(width, 1);
+    if (center == windowCenter && width == windowWidth) return;
+    windowCenter = center;
+    windowWidth = width;
+
+    {
+        QSignalBlocker bc(wcSlider);
+        QSignalBlocker bw(wwSlider);
+        wcSlider->setValue(center);
+        wwSlider->setValue(width);
+    }
+    seriesHistogram->setRange(windowCenter - windowWidth / 2.0, windowCenter + windowWidth / 2.0);
+    // the player takes the new LUT and drains what it windowed with the old one
+    if (cine->isPlaying()) {
+        auto* cached = volumeCache.find(currentSeriesUID);
+        if (cached && windowLut.update(**cached, windowCenter, windowWidth)) pixmapCache.clear();
+        cine->setLut(windowLut);
+        return;
+    }
+    renderCurrentSlice();
+}
+
+void MainWindow::renderCurrentSlice() {
+    D3M_TRACE_SCOPE("frame.windowLevel");
+    if (mprMode) {
+        updateMprViews();
+        return;
+    }
+    auto* cached = volumeCache.find(currentSeriesUID);
+    if (!cached) return;
+    d3m::Volume& volume = **cached;
+    if (currentSlice < 0 || currentSlice >= volume.depth()) return;
+    if (!projectionMode && !volume.isSliceLoaded(currentSlice)) return;
+
+    // only the table is rebuilt on a W/L change, pixels go through one lookup each
+    if (windowLut.update(volume, windowCenter, windowWidth))
+        pixmapCache.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+    QImage image = renderPlaneImage(volume, d3m::Plane::Axial, currentSlice);
+    {
+        D3M_TRACE_SCOPE("scene");
+        m_view->updateBaseImage(image);
+    }
+    if (projectionMode) {
+        statusBar()->showMessage(QString("W/L: %1 / %2 | %3 of %4 slices: %5 ms")
+            .arg(windowWidth).arg(windowCenter).arg(projectionCombo->currentText()).arg(slabThickness)
+            .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1));
+        return;
+    }
+    statusBar()->showMessage(QString("W/L: %1 / %2").arg(windowWidth).arg(windowCenter));
+}
+
+// Fills the preset box for the current series: Auto first, then the
+// windows its first file lists, then the modality presets. True if the
+// file lists any. The W/L sliders are widened to the values the series can
+// hold and to every preset before any of them is applied.
+bool MainWindow::populateWindowPresets() {
+    windowCombo->clear();
+    windowCombo->addItem("Auto");
+    auto it = seriesMap.find(currentSeriesUID);
+    if (it == seriesMap.end() || it->second.empty()) return false;
+
+    const d3m::SliceInfo& first = it->second.front();
+    const int bits = std::clamp(first.bitsStored, 1, 16);
+    const double vmin = first.pixelRepresentation == 1 ? -std::ldexp(1.0, bits - 1) : 0.0;
+    const double vmax = first.pixelRepresentation == 1 ? std::ldexp(1.0, bits - 1) - 1.0 : std::ldexp(1.0, bits) - 1.0;
+    widenWindowRange(vmin * first.rescaleSlope + first.rescaleIntercept, vmax * first.rescaleSlope + first.rescaleIntercept);
+
+    auto add = [this](const auto& w) {
+        windowCombo->addItem(w.name, QPoint(w.center, w.width));
+        widenWindowRange(w.center - w.width / 2.0, w.center + w.width / 2.0);
+    };
+    const auto tagged = d3m::sliceWindows(first);
+    for (const auto& w : tagged) add(w);
+    const QString modality = d3m::tagValue(first.tags, d3m::tagKey(d3m::Modality.group, d3m::Modality.element));
+    for (const auto& w : d3m::modalityWindows(modality)) add(w);
+    return !tagged.empty();
+}
+
+// A preset is only a new LUT; "Auto" reads the percentiles off the series
+// histogram. Until every slice is counted that is what has been decoded so
+// far; the rest then decodes in the background and Auto is applied again.
+void MainWindow::applyWindowPreset(int index) {
+    if (index < 0 || index >= windowCombo->count()) return;
+    windowCombo->setCurrentIndex(index);
+    const QVariant data = windowCombo->itemData(index);
+    if (data.isValid()) {
+        const QPoint w = data.toPoint();
+        setWindowLevel(w.x(), w.y());
+        return;
+    }
+    auto* cached = volumeCache.find(currentSeriesUID);
+    int center = 0, width = 0;
+    if (!cached || !d3m::autoWindow(**cached, center, width)) return;
+    setWindowLevel(center, width);
+    autoShown = QPoint(windowCenter, windowWidth);
+    if (!histogramComplete(**cached)) {
+        autoRequested = false;
+        autoRefresh->start();
+    }
+}
+
+// Redraws the series histogram and widens the W/L sliders to its range
+void MainWindow::updateSeriesHistogram(const d3m::Volume& volume) {
+    histogramShown = volume.loadedSlices();
+    int lo = 0, hi = 0;
+    if (!volume.histogram().range(lo, hi)) {
+        seriesHistogram->clear();
+        return;
+    }
+    constexpr int Bins = 128;
+    const double slope = volume.rescaleSlope();
+    const double a = lo * slope + volume.rescaleIntercept();
+    const double b = hi * slope + volume.rescaleIntercept();
+    seriesHistogram->setHistogram(volume.histogram().binned(Bins, lo, hi), std::min(a, b),
+                                  (hi - lo + 1) * std::abs(slope) / Bins);
+    seriesHistogram->setRange(windowCenter - windowWidth / 2.0, windowCenter + windowWidth / 2.0);
+    widenWindowRange(a, b);
+}
+
+// Grows the W/L sliders to cover modality values lo..hi. Ranges only grow,
+// and the sliders are moved back to the current window in case it lay
+// outside them before.
+void MainWindow::widenWindowRange(double lo, double hi) {
+    if (lo > hi) std::swap(lo, hi);
+    QSignalBlocker bc(wcSlider);
+    QSignalBlocker bw(wwSlider);
+    wcSlider->setRange(std::min(wcSlider->minimum(), static_cast<int>(std::floor(lo))),
+                       std::max(wcSlider->maximum(), static_cast<int>(std::ceil(hi))));
+    wwSlider->setMaximum(std::max(wwSlider->maximum(), static_cast<int>(std::ceil(hi - lo)) + 1));
+    wcSlider->setValue(windowCenter);
+    wwSlider->setValue(windowWidth);
+}
+
+void MainWindow::onToggleMpr(bool checked) {
+    cineBtn->setChecked(false);
+    mprMode = checked;
+    viewStack->setCurrentIndex(checked ? 1 : 0);
+    lastShownSlice = -1;
+    if (checked) {
+        startMpr();
+    } else {
+        mprRefresh->stop();
+        prefetcher.cancel();
+    }
+    showSlice(currentSlice);
+}
+
+// Reformatting needs the whole volume: decode all of it in the background,
+// nearest to the current slice first, and centre the cursor in-plane
+void MainWindow::startMpr() {
+    auto volume = volumeFor(currentSeriesUID);
+    if (!volume) return;
+
+    mprCursor = {volume->width() / 2, volume->height() / 2, std::clamp(currentSlice, 0, volume->depth() - 1)};
+    mprLoadedShown = -1;
+    // the panes are index-space planes: named after the patient axis they face
+    for (std::size_t i = 0; i < mprTitles.size(); ++i)
+        mprTitles[i]->setText(d3m::planeName(*volume, static_cast<d3m::Plane>(i)));
+    prefetcher.requestAll(volume, mprCursor.z);
+    mprRefresh->start();
+}
+
+void MainWindow::updateMprViews() {
+    D3M_TRACE_SCOPE("frame.mpr");
+    auto volume = volumeFor(currentSeriesUID);
+    if (!volume) return;
+
+    if (windowLut.update(*volume, windowCenter, windowWidth))
+        pixmapCache.clear();
+    volume->loadSlice(mprCursor.z); // the axial plane should not wait for the background decode
+
+    QElapsedTimer timer;
+    timer.start();
+    for (std::size_t i = 0; i < mprViews.size(); ++i) {
+        const auto plane = static_cast<d3m::Plane>(i);
+        ImageView* view = mprViews[i];
+        view->setPixelAspect(d3m::planeAspect(*volume, plane));
+        view->updateBaseImage(renderPlaneImage(*volume, plane, d3m::planeIndex(plane, mprCursor)));
+
+        int u = 0, v = 0;
+        d3m::voxelToPlane(*volume, plane, mprCursor, u, v);
+        view->setCrosshair(QPointF(u, v));
+    }
+    const double ms = timer.nsecsElapsed() / 1e6;
+    mprLoadedShown = volume->loadedSlices();
+
+    statusBar()->showMessage(QString("MPR voxel (%1, %2, %3) | %4 / %5 slices decoded | %6 ms")
+        .arg(mprCursor.x).arg(mprCursor.y).arg(mprCursor.z)
+        .arg(mprLoadedShown).arg(volume->depth())
+        .arg(ms, 0, 'f', 1));
+}
+
+// One plane of the volume, or the slab around it when a projection is selected.
+// Axial slabs decode their centre slice here and the rest in the background,
+// drawn with what has been decoded so far; the other directions need the
+// whole volume, which MPR mode decodes in the background.
+QImage MainWindow::renderPlaneImage(d3m::Volume& volume, d3m::Plane plane, int index) {
+    if (!projectionMode && plane == d3m::Plane::Axial && fusing()) {
+        const auto colormap = static_cast<d3m::Colormap>(colormapCombo->currentData().toInt());
+        fusionLut.update(colormap, overlayOpacity);
+        QImage fused = d3m::renderFusedSlice(volume, index, windowLut, *fusionVolume, fusionWindowLut, fusionLut);
+        if (!fused.isNull()) return fused;
+    }
+    if (!projectionMode)
+        return d3m::renderPlane(volume, plane, index, windowLut);
+
+    if (plane == d3m::Plane::Axial) {
+        int first = 0, last = 0;
+        d3m::slabRange(volume, plane, index, slabThickness, first, last);
+        volume.loadSlice(index);
+        slabLoadedShown = slabLoadedSlices(volume, first, last);
+        auto* cached = volumeCache.find(currentSeriesUID);
+        if (!mprMode && slabLoadedShown < last - first && cached && cached->get() == &volume) {
+            prefetcher.requestRange(*cached, first, last, index);
+            slabRefresh->start();
+        }
+    }
+    return d3m::renderProjection(volume, plane, index, slabThickness, *projectionMode, windowLut);
+}
+
+void MainWindow::onMprCrosshair(d3m::Plane plane, const QPointF& imagePos) {
+    auto volume = volumeFor(currentSeriesUID);
+    if (!volume) return;
+
+    const int u = static_cast<int>(std::floor(imagePos.x()));
+    const int v = static_cast<int>(std::floor(imagePos.y()));
+    d3m::planeToVoxel(*volume, plane, u, v, mprCursor);
+
+    // the axial position goes through the slider so it stays in sync
+    if (mprCursor.z != currentSlice)
+        showSlice(mprCursor.z);
+    else
+        updateMprViews();
+}
+
+void MainWindow::onTogglePerfOverlay(bool checked) {
+    perfOverlay->setVisible(checked);
+    if (checked) {
+        updatePerfOverlay();
+        perfOverlay->raise();
+        perfTimer->start();
+    } else {
+        perfTimer->stop();
+    }
+}
+
+void MainWindow::updatePerfOverlay() {
+    const d3m::Tracer& tracer = d3m::Tracer::instance();
+    QStringList lines;
+    lines << QString("%1 %2 %3 %4 %5").arg("scope", -18).arg("n", 6).arg("p50", 8).arg("p95", 8).arg("p99", 8);
+    for (const char* name : {"frame.slice", "frame.windowLevel", "frame.mpr", "decode", "read.mapped", "read.gdcm",
+                             "window", "mpr.plane", "projection", "pixmap", "scene", "metadata",
+                             "cine.present", "tiles.paint", "tiles.pyramid", "roi.stats",
+                             "histogram", "fusion"}) {
+        const d3m::TraceStats s = tracer.stats(name);
+        if (s.count == 0) continue;
+        lines << QString("%1 %2 %3 %4 %5").arg(QString::fromLatin1(name), -18).arg(s.count, 6)
+            .arg(s.p50, 8, 'f', 2).arg(s.p95, 8, 'f', 2).arg(s.p99, 8, 'f', 2);
+    }
+    lines << QString("pixmap cache hit %1% | %2 MB cached")
+        .arg(qRound(pixmapCache.hitRate() * 100.0))
+        .arg((pixmapCache.bytes() + volumeCache.bytes()) >> 20);
+    perfOverlay->setText(lines.join('\n'));
+    perfOverlay->adjustSize();
+}
+
+void MainWindow::onExportTrace() {
+    QString fname = QFileDialog::getSaveFileName(this, "Export trace", "d3m-trace.json", "Chrome trace (*.json)");
+    if (fname.isEmpty()) return;
+    if (!d3m::Tracer::instance().exportChromeTrace(fname)) {
+        statusBar()->showMessage("Failed to write " + fname);
+        return;
+    }
+    statusBar()->showMessage("Trace written to " + fname + " (open in chrome://tracing or Perfetto)");
+}
+
+void MainWindow::onToggleCine(bool checked) {
+    cineBtn->setText(checked ? "Stop" : "Play");
+    if (checked) {
+        startCine();
+        if (!cine->isPlaying()) cineBtn->setChecked(false);
+        return;
+    }
+    if (!cine->isPlaying()) return;
+    cine->stop();
+    const d3m::CineStats& s = cine->stats();
+    // back to the regular path, which also brings the tags up to date
+    lastShownSlice = -1;
+    showSlice(currentSlice);
+    statusBar()->showMessage(QString("Cine stopped: %1 frames shown, %2 dropped, %3 stalls")
+        .arg(s.presented).arg(s.dropped).arg(s.stalls));
+}
+
+// Plays the plain axial slices from the current one; the background pool
+// decodes the rest of the series ahead of the player
+void MainWindow::startCine() {
+    if (mprMode || projectionMode) {
+        statusBar()->showMessage("Cine plays single slices; switch MPR and projections off first");
+        return;
+    }
+    auto volume = volumeFor(currentSeriesUID);
+    if (!volume || volume->depth() < 2) return;
+
+    windowLut.update(*volume, windowCenter, windowWidth);
+    prefetcher.requestAll(volume, currentSlice);
+    cine->start(volume, currentSlice, windowLut, fpsSpin->value());
+}
+
+void MainWindow::showCineFrame(int z, const QImage& image) {
+    currentSlice = z;
+    {
+        QSignalBlocker blocker(sliceSlider);
+        sliceSlider->setValue(z);
+    }
+    {
+        // same size every frame: only the pixmap is swapped, items and zoom stay
+        D3M_TRACE_SCOPE("scene");
+        m_view->updateBaseImage(image);
+    }
+
+    const d3m::CineStats& s = cine->stats();
+    if (s.presented % cine->fps() == 0) {
+        statusBar()->showMessage(QString("Cine %1 fps | slice %2 | interval %3 ms (max %4) | dropped %5 | stalls %6")
+            .arg(cine->fps()).arg(z + 1)
+            .arg(s.meanIntervalMs, 0, 'f', 1).arg(s.maxIntervalMs, 0, 'f', 1)
+            .arg(s.dropped).arg(s.stalls));
+    }
+}
+
 void MainWindow::onNextSlice() {
     currentSlice++;
     if (!showSlice(currentSlice))
@@ -373,23 +1197,43 @@ void MainWindow::onLoadDicom() {
     QString fname = QFileDialog::getOpenFileName(this, "Load DICOM file", QString(), "*");
     if (fname.isEmpty()) return;
 
-    gdcm::ImageReader reader;
-    reader.SetFileName(fname.toStdString().c_str());
-    if(!reader.Read()) {
+    std::vector<d3m::SliceInfo> frames = d3m::scanFile(fname);
+    if (frames.empty()) {
         statusBar()->showMessage("Failed to read DICOM file");
         return;
     }
 
-    gdcm::Image& gimg = reader.GetImage();
-    QImage qimg = gdcmImageToQImage(gimg, windowCenter, windowWidth);
-
-    if (qimg.isNull()) {
-        statusBar()->showMessage("Failed to convert DICOM to QImage");
+    // the file becomes a series of its own, frames decoded as they are shown;
+    // a single file of a series already loaded from a folder is kept apart
+    // from it under its path
+    QString uid = frames.front().seriesUID.isEmpty() ? fname : frames.front().seriesUID;
+    if (frames.size() == 1 && seriesMap.count(uid) && seriesMap[uid].size() > 1) uid = fname;
+    const QString desc = frames.front().seriesDesc.isEmpty() ? QFileInfo(fname).fileName() : frames.front().seriesDesc;
+    for (auto& frame : frames) frame.seriesUID = uid;
+    d3m::sortSeries(frames);
+
+    // decode the first frame up front, so an undecodable file is not listed
+    auto volume = std::make_shared<d3m::Volume>(frames);
+    if (!volume->loadSlice(0)) {
+        statusBar()->showMessage("Failed to decode DICOM pixel data");
         return;
     }
-
-    m_view->loadBaseImage(qimg);
-    m_view->fitInView(m_view->scene()->sceneRect(), Qt::KeepAspectRatio);
+    volumeCache.insert(uid, volume, volume->maxResidentBytes());
+    pixmapCache.clear();
+    seriesMap[uid] = std::move(frames);
+    int comboIndex = seriesCombo->findData(uid);
+    if (comboIndex < 0) {
+        fusionCombo->addItem(desc, uid);
+        seriesCombo->addItem(desc, uid);
+        comboIndex = seriesCombo->count() - 1;
+    }
+    if (uid == fusionSeriesUID) fusionVolume = volume;
+    if (seriesCombo->currentIndex() == comboIndex) {
+        lastShownSlice = -1;
+        showSlice(0);
+    } else {
+        seriesCombo->setCurrentIndex(comboIndex);
+    }
     statusBar()->showMessage("DICOM loaded: " + fname);
 }
 
@@ -402,7 +1246,6 @@ void MainWindow::onLoadBase() {
         return;
     }
     m_view->loadBaseImage(img);
-    m_view->fitInView(m_view->scene()->sceneRect(), Qt::KeepAspectRatio);
     statusBar()->showMessage("Base image loaded: " + fname);
 }
 
@@ -422,11 +1265,44 @@ void MainWindow::onLoadOverlay() {
 void MainWindow::onOpacityChanged(int value) {
     qreal o = value / 100.0;
     m_view->setOverlayOpacity(o);
+    overlayOpacity = o;
+    if (fusing()) renderCurrentSlice();
     statusBar()->showMessage(QString("Overlay opacity: %1%").arg(value));
 }
 
 void MainWindow::onToggleOverlay(bool checked) {
     m_view->setOverlayVisible(checked);
+    overlayVisible = checked;
+    if (fusionVolume) renderCurrentSlice();
+}
+
+bool MainWindow::fusing() const {
+    return fusionVolume && overlayVisible && !mprMode;
+}
+
+// Fusion overlay from the folder's series: the base stays as it is, the
+// overlay gets its own window (the file's, else auto) and is resampled per
+// slice at render time
+void MainWindow::setFusionSeries(int index) {
+    cineBtn->setChecked(false);
+    fusionSeriesUID = fusionCombo->itemData(index).toString();
+    fusionVolume.reset();
+    auto series = seriesMap.find(fusionSeriesUID);
+    if (series != seriesMap.end() && !series->second.empty()) {
+        fusionVolume = volumeFor(fusionSeriesUID);
+        const auto tagged = d3m::sliceWindows(series->second.front());
+        int center = 0, width = 0;
+        if (!tagged.empty()) {
+            center = tagged.front().center;
+            width = tagged.front().width;
+        } else {
+            fusionVolume->loadSlice(fusionVolume->depth() / 2);
+            if (!d3m::autoWindow(*fusionVolume, center, width)) width = 1;
+        }
+        fusionWindowLut.update(*fusionVolume, center, width);
+        statusBar()->showMessage(QString("Fusing %1, W/L %2 / %3").arg(fusionCombo->itemText(index)).arg(width).arg(center));
+    }
+    renderCurrentSlice();
 }
 
 void MainWindow::onStartDrawROI() {
@@ -435,72 +1311,128 @@ void MainWindow::onStartDrawROI() {
 }
 
 void MainWindow::onClearROI() {
-    // remove rectangles (z value 2)
-    for (auto item : m_view->scene()->items()) {
-        if (item->zValue() == 2) {
-            m_view->scene()->removeItem(item);
-            delete item;
-        }
-    }
+    m_view->clearRois();
+    roiRect.reset();
+    updateRoiStats();
     statusBar()->showMessage("ROI cleared");
 }
 
-void MainWindow::onROIFinished(const QRectF& rect) {
-    // Convert scene rect to image (pixel) coords if needed.
-    // If base image at (0,0) and no transforms were applied, scene coords == pixel coords.
-    QRectF pixelRect = rect; // for now assume 1:1 mapping
-    statusBar()->showMessage(QString("ROI: x=%1 y=%2 w=%3 h=%4")
-                                 .arg(pixelRect.x()).arg(pixelRect.y())
-                                 .arg(pixelRect.width()).arg(pixelRect.height()));
+void MainWindow::onROIFinished(const QRectF&) {
+    auto stats = updateRoiStats();
+    if (!stats) return;
+    statusBar()->showMessage(QString("ROI: mean %1 SD %2 min %3 max %4 | %5 mm2 | %6 voxels")
+        .arg(stats->mean, 0, 'f', 1).arg(stats->sd, 0, 'f', 1)
+        .arg(stats->min, 0, 'f', 1).arg(stats->max, 0, 'f', 1)
+        .arg(stats->areaMm2, 0, 'f', 1).arg(stats->count));
 }
 
-void MainWindow::loadDicomMetadata(const QString& file) {
-    metaTree->clear();
-
-    gdcm::Reader reader;
-    reader.SetFileName(file.toStdString().c_str());
-    if (!reader.Read()) return;
-
-    const gdcm::DataSet& ds = reader.GetFile().GetDataSet();
-    gdcm::StringFilter sf;
-    sf.SetFile(reader.GetFile());
-
-    const gdcm::Dicts& dicts = gdcm::Global::GetInstance().GetDicts();
-    const gdcm::Dict& pubDict = dicts.GetPublicDict();
-
-    for (gdcm::DataSet::ConstIterator it = ds.Begin(); it != ds.End(); ++it) {
-        const gdcm::DataElement& de = *it;
-        gdcm::Tag tag = de.GetTag();
-
-        QString tagStr = QString("(%1,%2)")
-            .arg(tag.GetGroup(), 4, 16, QLatin1Char('0'))
-            .arg(tag.GetElement(), 4, 16, QLatin1Char('0'))
-            .toUpper();
-        
-        QString value = QString::fromStdString(sf.ToString(de));
+// Measures the ROI on the current slice (or through the slab with "3D ROI")
+// from the stored values, so the numbers are modality units (HU for CT),
+// independent of the window. Image rows are flipped relative to the stored rows.
+std::optional<d3m::RoiStats> MainWindow::updateRoiStats() {
+    auto* cached = roiRect && !mprMode ? volumeCache.find(currentSeriesUID) : nullptr;
+    if (!cached) {
+        roiLabel->clear();
+        roiHistogram->clear();
+        return std::nullopt;
+    }
+    d3m::Volume& volume = **cached;
+
+    const QRect px = roiRect->toAlignedRect();
+    d3m::RoiBox box;
+    box.x0 = px.left();
+    box.x1 = px.left() + px.width();
+    box.y0 = volume.height() - (px.top() + px.height());
+    box.y1 = volume.height() - px.top();
+    box.z0 = currentSlice;
+    box.z1 = currentSlice + 1;
+    if (roi3dToggle->isChecked()) {
+        // like a projection slab: the current slice decodes here, the rest in
+        // the background (asked for once per slab, not on every drag step),
+        // measured over what has been decoded so far
+        d3m::slabRange(volume, d3m::Plane::Axial, currentSlice, slabThickness, box.z0, box.z1);
+        volume.loadSlice(currentSlice);
+        if (slabLoadedSlices(volume, box.z0, box.z1) < box.z1 - box.z0) {
+            if (roiRequested != std::make_pair(box.z0, box.z1)) {
+                prefetcher.requestRange(*cached, box.z0, box.z1, currentSlice);
+                roiRequested = {box.z0, box.z1};
+            }
+            roiRefresh->start();
+        }
+    }
 
-        // lookup name in DICOM dictionary
-        const gdcm::DictEntry& entry = pubDict.GetDictEntry(tag);
-        QString keyword = QString::fromStdString(entry.GetKeyword());
-        gdcm::VR vr = entry.GetVR();
-        QString vrStr = QString::fromStdString(gdcm::VR::GetVRString(vr));
+    const d3m::RoiStats stats = d3m::computeRoiStats(volume, box);
+    roiSlicesShown = stats.slices;
+    if (stats.count == 0) {
+        roiLabel->setText("ROI: no pixels");
+        roiHistogram->clear();
+        return stats;
+    }
+    QString text = QString("Mean %1  SD %2\nMin %3  Max %4\nArea %5 mm\u00B2  (%6 px)")
+        .arg(stats.mean, 0, 'f', 1).arg(stats.sd, 0, 'f', 1)
+        .arg(stats.min, 0, 'f', 1).arg(stats.max, 0, 'f', 1)
+        .arg(stats.areaMm2, 0, 'f', 1).arg(stats.count);
+    if (box.z1 - box.z0 > 1 && stats.slices < box.z1 - box.z0)
+        text += QString("\nVolume %1 mm\u00B3 over %2 of %3 slices").arg(stats.volumeMm3, 0, 'f', 0)
+            .arg(stats.slices).arg(box.z1 - box.z0);
+    else if (box.z1 - box.z0 > 1)
+        text += QString("\nVolume %1 mm\u00B3 over %2 slices").arg(stats.volumeMm3, 0, 'f', 0).arg(stats.slices);
+    roiLabel->setText(text);
+    roiHistogram->setHistogram(stats.histogram, stats.min, stats.binWidth);
+    return stats;
+}
 
-        QTreeWidgetItem* item = new QTreeWidgetItem(metaTree);
-        item->setText(0, tagStr + " " + keyword);
-        item->setText(1, value);
-        item->setText(2, vrStr);
+void MainWindow::filterMetadata(const QString& text) {
+    searchResults->clear();
+    searchHits.clear();
+    if (text.trimmed().isEmpty() || !searchIndex) {
+        searchStatus->clear();
+        applyMetadataFilter();
+        return;
     }
 
-    metaTree->expandAll();
+    QElapsedTimer timer;
+    timer.start();
+    searchHits = searchIndex->search(text);
+    const double ms = timer.nsecsElapsed() / 1e6;
+
+    int shown = 0;
+    for (int id : searchHits) {
+        if (shown++ == MaxSearchResults) break;
+        const auto& doc = searchIndex->document(id);
+        const auto series = seriesMap.find(searchIndex->seriesKey(doc.series));
+        if (series == seriesMap.end()) continue;
+        const QString& desc = series->second.front().seriesDesc;
+        auto* item = new QListWidgetItem(QString("%1 | %2 %3 = %4 (%5 slices)")
+            .arg(desc.isEmpty() ? series->first : desc)
+            .arg(d3m::tagString(doc.tag), d3m::tagKeyword(doc.tag), doc.value)
+            .arg(doc.slices.size()), searchResults);
+        item->setData(Qt::UserRole, id);
+    }
+    searchStatus->setText(QString("%1 matches (%2 ms)").arg(searchHits.size()).arg(ms, 0, 'f', 2));
+    applyMetadataFilter();
 }
 
-void MainWindow::filterMetadata(const QString& text) {
-    for (int i = 0; i < metaTree->topLevelItemCount(); ++i) {
-        QTreeWidgetItem* item = metaTree->topLevelItem(i);
-        bool match = item->text(0).contains(text, Qt::CaseInsensitive) ||
-                     item->text(1).contains(text, Qt::CaseInsensitive) ||
-                     item->text(2).contains(text, Qt::CaseInsensitive);
-        item->setHidden(!match);
+void MainWindow::applyMetadataFilter() {
+    const d3m::TagStore& rows = metaModel->tags();
+    if (metaFilter->text().trimmed().isEmpty() || !searchIndex) {
+        for (int row = 0; row < static_cast<int>(rows.size()); ++row)
+            metaView->setRowHidden(row, QModelIndex(), false);
+        return;
+    }
+
+    // show the rows of the current slice that are among the hits
+    std::vector<uint32_t> tagsHere;
+    for (int id : searchHits) {
+        const auto& doc = searchIndex->document(id);
+        if (searchIndex->seriesKey(doc.series) == currentSeriesUID &&
+            std::binary_search(doc.slices.begin(), doc.slices.end(), currentSlice))
+            tagsHere.push_back(doc.tag);
+    }
+    std::sort(tagsHere.begin(), tagsHere.end());
+    for (int row = 0; row < static_cast<int>(rows.size()); ++row) {
+        const bool match = std::binary_search(tagsHere.begin(), tagsHere.end(), rows[row].tag);
+        metaView->setRowHidden(row, QModelIndex(), !match);
     }
 }
 
@@ -512,18 +1444,18 @@ void MainWindow::extractSliceMetadata(const QString& file) {
     const gdcm::File& f = reader.GetFile();
     const gdcm::DataSet& ds = f.GetDataSet();
 
-    double pixelSpacingX = getNumericTag(f, ds, d3m::PixelSpacing.group, d3m::PixelSpacing.element, 0);
-    double pixelSpacingY = getNumericTag(f, ds, d3m::PixelSpacing.group, d3m::PixelSpacing.element, 1);
-    double sliceThickness = getNumericTag(f, ds, d3m::SliceThickness.group, d3m::SliceThickness.element);
-    double imagePosX = getNumericTag(f, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 0);
-    double imagePosY = getNumericTag(f, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 1);
-    double imagePosZ = getNumericTag(f, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 2);
-    double rowCosX = getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 0);
-    double rowCosY = getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 1);
-    double rowCosZ = getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 2);
-    double colCosX = getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 3);
-    double colCosY = getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 4);
-    double colCosZ = getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 5);
+    double pixelSpacingX = d3m::getNumericTag(f, ds, d3m::PixelSpacing.group, d3m::PixelSpacing.element, 0);
+    double pixelSpacingY = d3m::getNumericTag(f, ds, d3m::PixelSpacing.group, d3m::PixelSpacing.element, 1);
+    double sliceThickness = d3m::getNumericTag(f, ds, d3m::SliceThickness.group, d3m::SliceThickness.element);
+    double imagePosX = d3m::getNumericTag(f, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 0);
+    double imagePosY = d3m::getNumericTag(f, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 1);
+    double imagePosZ = d3m::getNumericTag(f, ds, d3m::ImagePositionPatient.group, d3m::ImagePositionPatient.element, 2);
+    double rowCosX = d3m::getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 0);
+    double rowCosY = d3m::getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 1);
+    double rowCosZ = d3m::getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 2);
+    double colCosX = d3m::getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 3);
+    double colCosY = d3m::getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 4);
+    double colCosZ = d3m::getNumericTag(f, ds, d3m::ImageOrientationPatient.group, d3m::ImageOrientationPatient.element, 5);
 
     QDebug(QtMsgType::QtInfoMsg) << "Pixel spacing: " << pixelSpacingX << pixelSpacingY;
     QDebug(QtMsgType::QtInfoMsg) << "Pixel spacing: " << sliceThickness;
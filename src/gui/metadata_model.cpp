@@ -0,0 +1,65 @@
+#include "gui/metadata_model.h"
+#include "dicom/trace.h"
+
+MetadataModel::MetadataModel(QObject* parent) : QAbstractTableModel(parent) {}
+
+bool MetadataModel::sameLayout(const d3m::TagStore& tags) const {
+    if (tags.size() != m_tags.size()) return false;
+    for (std::size_t i = 0; i < tags.size(); ++i) {
+        if (tags[i].tag != m_tags[i].tag) return false;
+    }
+    return true;
+}
+
+void MetadataModel::setTags(const d3m::TagStore& tags) {
+    D3M_TRACE_SCOPE("metadata");
+    if (!sameLayout(tags)) {
+        beginResetModel();
+        m_tags = tags;
+        endResetModel();
+        return;
+    }
+
+    // same tags in the same order: refresh only the runs of changed values
+    int first = -1;
+    const int n = static_cast<int>(tags.size());
+    for (int row = 0; row <= n; ++row) {
+        const bool changed = row < n && tags[row].value != m_tags[row].value;
+        if (changed) {
+            m_tags[row].value = tags[row].value;
+            if (first < 0) first = row;
+        } else if (first >= 0) {
+            emit dataChanged(index(first, ValueColumn), index(row - 1, ValueColumn), {Qt::DisplayRole});
+            first = -1;
+        }
+    }
+}
+
+int MetadataModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(m_tags.size());
+}
+
+int MetadataModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant MetadataModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || role != Qt::DisplayRole) return QVariant();
+    const d3m::TagEntry& e = m_tags[index.row()];
+    switch (index.column()) {
+    case TagColumn:   return d3m::tagString(e.tag) + " " + d3m::tagKeyword(e.tag);
+    case ValueColumn: return e.value;
+    case VRColumn:    return d3m::tagVR(e.tag);
+    default:          return QVariant();
+    }
+}
+
+QVariant MetadataModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+    switch (section) {
+    case TagColumn:   return QString("Tag");
+    case ValueColumn: return QString("Value");
+    case VRColumn:    return QString("VR");
+    default:          return QVariant();
+    }
+}
@@ -0,0 +1,81 @@
+#include "gui/tiled_image_item.h"
+#include "dicom/trace.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include <algorithm>
+#include <cmath>
+
+TiledImageItem::TiledImageItem(QGraphicsItem* parent) : QGraphicsItem(parent), m_levels(1) {
+    // exposedRect is only filled in with this flag
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+void TiledImageItem::setImage(const QImage& image) {
+    if (image.size() != m_levels.front().size()) prepareGeometryChange();
+    m_levels.assign(1, image);
+    m_tiles.clear();
+    update();
+}
+
+QRectF TiledImageItem::boundingRect() const {
+    return QRectF(QPointF(0, 0), m_levels.front().size());
+}
+
+// Smallest level that still has at least one image pixel per screen pixel
+int TiledImageItem::levelFor(qreal lod) {
+    if (lod >= 1.0) return 0;
+    int index = static_cast<int>(std::floor(std::log2(1.0 / lod)));
+    const QSize full = m_levels.front().size();
+    while (index > 0 && std::max(full.width(), full.height()) >> index < TileSize) --index;
+    return index;
+}
+
+const QImage& TiledImageItem::level(int index) {
+    while (static_cast<int>(m_levels.size()) <= index) {
+        D3M_TRACE_SCOPE("tiles.pyramid");
+        const QImage& prev = m_levels.back();
+        m_levels.push_back(prev.scaled(std::max(1, prev.width() / 2), std::max(1, prev.height() / 2),
+                                       Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    }
+    return m_levels[index];
+}
+
+const QPixmap& TiledImageItem::tile(int lvl, int tx, int ty) {
+    const TileKey key{lvl, tx, ty};
+    if (const QPixmap* cached = m_tiles.find(key)) return *cached;
+
+    const QImage& src = level(lvl);
+    const QRect r = QRect(tx * TileSize, ty * TileSize, TileSize, TileSize).intersected(src.rect());
+    QPixmap pixmap = QPixmap::fromImage(src.copy(r));
+    const std::size_t cost = static_cast<std::size_t>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    m_tiles.insert(key, std::move(pixmap), cost);
+    return *m_tiles.find(key);
+}
+
+void TiledImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*) {
+    if (m_levels.front().isNull()) return;
+    D3M_TRACE_SCOPE("tiles.paint");
+
+    const int lvl = levelFor(option->levelOfDetailFromTransform(painter->worldTransform()));
+    const QImage& src = level(lvl);
+    // level pixels -> item (full resolution) pixels
+    const qreal sx = static_cast<qreal>(m_levels.front().width()) / src.width();
+    const qreal sy = static_cast<qreal>(m_levels.front().height()) / src.height();
+
+    const QRectF exposed = option->exposedRect.intersected(boundingRect());
+    if (exposed.isEmpty()) return;
+    const int tx0 = static_cast<int>(exposed.left() / sx) / TileSize;
+    const int ty0 = static_cast<int>(exposed.top() / sy) / TileSize;
+    const int tx1 = std::min(static_cast<int>(std::ceil(exposed.right() / sx)), src.width() - 1) / TileSize;
+    const int ty1 = std::min(static_cast<int>(std::ceil(exposed.bottom() / sy)), src.height() - 1) / TileSize;
+
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            const QPixmap& pixmap = tile(lvl, tx, ty);
+            const QRectF target(tx * TileSize * sx, ty * TileSize * sy, pixmap.width() * sx, pixmap.height() * sy);
+            painter->drawPixmap(target, pixmap, QRectF(pixmap.rect()));
+        }
+    }
+}
@@ -0,0 +1,402 @@
+// d3m-convert: batch export of DICOM folders without the GUI.
+//
+// Headers are scanned with the same SeriesLoader (and on-disk index) as the
+// viewer, then every slice goes through a bounded pipeline:
+//
+//   decode (N workers) -> window + encode (N workers) -> write (main thread)
+//
+// Decoding reads straight from the file into the series Volume (mapped for
+// uncompressed data), so reading and decoding are one stage. The queues
+// between the stages hold a few items per worker, which keeps memory flat
+// no matter how large the export is.
+
+#include "dicom/bounded_queue.h"
+#include "dicom/series_loader.h"
+#include "dicom/volume.h"
+#include "dicom/window_lut.h"
+#include "dicom/window_presets.h"
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QImage>
+#include <QRegularExpression>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+enum class Format {
+    Png,    // windowed 8-bit, one file per slice, oriented as in the viewer
+    Raw,    // stored values, one file per series, type and rescale in a .txt beside it
+    Nrrd,   // stored values with geometry header, one file per series
+};
+
+struct Series {
+    QString name;   // output file / directory name
+    std::vector<d3m::SliceInfo> slices;
+    std::once_flag created;
+    std::shared_ptr<d3m::Volume> volume;   // created by the first slice decoded
+    std::atomic<int> pending{0};           // slices not encoded yet
+    std::once_flag headerBuilt;
+    QByteArray header;                     // NRRD header, built while the volume is alive
+    QString rawName;                       // raw file name, with the volume's pixel type
+    QByteArray rawInfo;                    // its .txt sidecar
+    std::unique_ptr<QFile> file;           // per-series output, owned by the writer
+    int written = 0;
+};
+
+struct Job {
+    Series* series;
+    int z;
+};
+
+struct Decoded {
+    Series* series;
+    int z;
+    std::shared_ptr<d3m::Volume> volume;
+    d3m::Volume::SliceRef pixels; // held until encoded, null if decoding failed
+};
+
+struct Encoded {
+    Series* series;
+    int z;
+    QByteArray bytes;
+    QString error;  // printed by the writer; err() is not thread-safe
+};
+
+QTextStream& out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream& err() {
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+QString outputName(int index, const d3m::SliceInfo& first) {
+    QString desc = first.seriesDesc.trimmed();
+    if (desc.isEmpty()) desc = first.seriesUID;
+    desc.replace(QRegularExpression("[^A-Za-z0-9_.-]+"), "_");
+    return QString("%1_%2").arg(index, 3, 10, QChar('0')).arg(desc);
+}
+
+QString pixelTypeName(const d3m::Volume& volume) {
+    return volume.pixelType() == d3m::PixelType::Int16 ? "int16" : "uint16";
+}
+
+// Geometry goes in the header; the slice step is taken from the first two
+// positions so the direction of the stack is kept.
+QByteArray nrrdHeader(const Series& series, const d3m::Volume& volume) {
+    const auto& s = series.slices;
+    const d3m::Vec3& r = volume.rowCosines();
+    const d3m::Vec3& c = volume.colCosines();
+    d3m::Vec3 step = {volume.normal()[0] * volume.spacingZ(),
+                      volume.normal()[1] * volume.spacingZ(),
+                      volume.normal()[2] * volume.spacingZ()};
+    if (s.size() > 1)
+        step = {s[1].imagePosX - s[0].imagePosX, s[1].imagePosY - s[0].imagePosY, s[1].imagePosZ - s[0].imagePosZ};
+    auto vec = [](double x, double y, double z) { return QString("(%1,%2,%3)").arg(x).arg(y).arg(z); };
+
+    QString h;
+    QTextStream ts(&h);
+    ts << "NRRD0004\n"
+       << "# stored values; modality value = stored * " << volume.rescaleSlope()
+       << " + " << volume.rescaleIntercept() << "\n"
+       << "type: " << pixelTypeName(volume) << "\n"
+       << "dimension: 3\n"
+       << "sizes: " << volume.width() << " " << volume.height() << " " << volume.depth() << "\n"
+       << "space: left-posterior-superior\n"
+       << "space directions: "
+       << vec(r[0] * volume.spacingX(), r[1] * volume.spacingX(), r[2] * volume.spacingX()) << " "
+       << vec(c[0] * volume.spacingY(), c[1] * volume.spacingY(), c[2] * volume.spacingY()) << " "
+       << vec(step[0], step[1], step[2]) << "\n"
+       << "space origin: " << vec(volume.origin()[0], volume.origin()[1], volume.origin()[2]) << "\n"
+       << "kinds: domain domain domain\n"
+       << "endian: " << (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? "little" : "big") << "\n"
+       << "encoding: raw\n\n";
+    ts.flush();
+    return h.toLatin1();
+}
+
+// The raw file holds the Volume's stored values, which for a series with
+// mixed rescales are not the files' own: type and rescale come from the
+// volume, the rescale goes into a sidecar next to it.
+QString rawFileName(const Series& series, const d3m::Volume& volume) {
+    return QString("%1_%2x%3x%4_%5.raw").arg(series.name).arg(volume.width()).arg(volume.height())
+        .arg(volume.depth()).arg(pixelTypeName(volume));
+}
+
+QByteArray rawSidecar(const d3m::Volume& volume) {
+    QString h;
+    QTextStream ts(&h);
+    ts << "# stored values; modality value = stored * slope + intercept\n"
+       << "type: " << pixelTypeName(volume) << "\n"
+       << "sizes: " << volume.width() << " " << volume.height() << " " << volume.depth() << "\n"
+       << "endian: " << (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? "little" : "big") << "\n"
+       << "slope: " << volume.rescaleSlope() << "\n"
+       << "intercept: " << volume.rescaleIntercept() << "\n";
+    ts.flush();
+    return h.toLatin1();
+}
+
+bool parseWindow(const QString& text, int& center, int& width) {
+    if (auto preset = d3m::findWindowPreset(text)) {
+        center = preset->center;
+        width = preset->width;
+        return true;
+    }
+    const QStringList parts = text.split(',');
+    if (parts.size() != 2) return false;
+    bool okC = false, okW = false;
+    center = parts[0].trimmed().toInt(&okC);
+    width = parts[1].trimmed().toInt(&okW);
+    return okC && okW && width > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("d3m-convert");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Convert every DICOM series of a folder to PNG, raw or NRRD.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Folder with the DICOM files.");
+    parser.addPositionalArgument("output", "Output folder (created if missing).");
+    QCommandLineOption formatOpt({"f", "format"}, "png, raw or nrrd (default png).", "format", "png");
+    QCommandLineOption windowOpt({"w", "window"}, "Window preset name or center,width for PNG output (default soft-tissue).",
+                                 "window", "soft-tissue");
+    QCommandLineOption jobsOpt({"j", "jobs"}, "Workers per pipeline stage (default: all cores).", "n",
+                               QString::number(QThread::idealThreadCount()));
+    QCommandLineOption presetsOpt("list-presets", "List the window presets and exit.");
+    parser.addOption(formatOpt);
+    parser.addOption(windowOpt);
+    parser.addOption(jobsOpt);
+    parser.addOption(presetsOpt);
+    parser.process(app);
+
+    if (parser.isSet(presetsOpt)) {
+        for (const auto& p : d3m::WindowPresets)
+            out() << QString("%1 %2 %3").arg(QString::fromLatin1(p.name), -12).arg(p.center, 6).arg(p.width, 6) << "\n";
+        return 0;
+    }
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 2) parser.showHelp(1);
+
+    Format format = Format::Png;
+    const QString formatName = parser.value(formatOpt).toLower();
+    if (formatName == "raw") format = Format::Raw;
+    else if (formatName == "nrrd") format = Format::Nrrd;
+    else if (formatName != "png") {
+        err() << "unknown format: " << formatName << "\n";
+        return 1;
+    }
+
+    int windowCenter = 0, windowWidth = 0;
+    if (!parseWindow(parser.value(windowOpt), windowCenter, windowWidth)) {
+        err() << "bad window: " << parser.value(windowOpt) << " (see --list-presets)\n";
+        return 1;
+    }
+    const int jobs = std::max(1, parser.value(jobsOpt).toInt());
+
+    QDir inputDir(args[0]);
+    QDir outputDir(args[1]);
+    if (!outputDir.mkpath(".")) {
+        err() << "cannot create " << args[1] << "\n";
+        return 1;
+    }
+
+    QStringList files;
+    for (const QString& f : inputDir.entryList(QDir::Files))
+        files << inputDir.absoluteFilePath(f);
+    if (files.isEmpty()) {
+        err() << "no files in " << args[0] << "\n";
+        return 1;
+    }
+
+    QElapsedTimer total;
+    total.start();
+
+    // header scan, same loader and index as the viewer
+    d3m::SeriesLoader loader;
+    QEventLoop loop;
+    QObject::connect(&loader, &d3m::SeriesLoader::finished, &loop, &QEventLoop::quit);
+    QObject::connect(&loader, &d3m::SeriesLoader::cancelled, &loop, &QEventLoop::quit);
+    loader.start(files);
+    loop.exec();
+    auto seriesMap = loader.takeResult();
+    if (!seriesMap || seriesMap->empty()) {
+        err() << "no DICOM series found in " << args[0] << "\n";
+        return 1;
+    }
+    out() << QString("Scanned %1 files (%2 parsed) into %3 series in %4 s\n")
+        .arg(files.size()).arg(loader.scannedFiles()).arg(seriesMap->size())
+        .arg(total.nsecsElapsed() / 1e9, 0, 'f', 2);
+    out().flush();
+
+    std::vector<std::unique_ptr<Series>> series;
+    std::vector<Job> work;
+    for (auto& [uid, slices] : *seriesMap) {
+        auto s = std::make_unique<Series>();
+        s->name = outputName(static_cast<int>(series.size()), slices.front());
+        s->slices = std::move(slices);
+        s->pending = static_cast<int>(s->slices.size());
+        for (int z = 0; z < static_cast<int>(s->slices.size()); ++z)
+            work.push_back({s.get(), z});
+        if (format == Format::Png && !outputDir.mkpath(s->name)) {
+            err() << "cannot create " << outputDir.filePath(s->name) << "\n";
+            return 1;
+        }
+        series.push_back(std::move(s));
+    }
+    seriesMap.reset();
+
+    QElapsedTimer convert;
+    convert.start();
+
+    d3m::BoundedQueue<Decoded> decoded(2 * jobs);
+    d3m::BoundedQueue<Encoded> encoded(2 * jobs);
+    std::atomic<std::size_t> next{0};
+    std::atomic<int> decodersLeft{jobs};
+    std::atomic<int> encodersLeft{jobs};
+    std::atomic<int> failed{0};
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(2 * jobs);
+
+    for (int i = 0; i < jobs; ++i) {
+        pool.start([&] {
+            for (;;) {
+                const std::size_t j = next.fetch_add(1);
+                if (j >= work.size()) break;
+                Series& s = *work[j].series;
+                std::call_once(s.created, [&] { s.volume = std::make_shared<d3m::Volume>(s.slices); });
+                auto volume = s.volume;
+                d3m::Volume::SliceRef pixels;
+                if (volume->loadSlice(work[j].z)) pixels = volume->sliceRef(work[j].z);
+                if (!decoded.push({&s, work[j].z, std::move(volume), std::move(pixels)})) break;
+            }
+            if (--decodersLeft == 0) decoded.close();
+        });
+    }
+
+    for (int i = 0; i < jobs; ++i) {
+        pool.start([&] {
+            d3m::WindowLut lut;
+            while (auto item = decoded.pop()) {
+                const d3m::Volume& volume = *item->volume;
+                const qsizetype sliceBytes = static_cast<qsizetype>(volume.sliceSize() * sizeof(uint16_t));
+                QByteArray bytes;
+                QString error;
+                if (!item->pixels) {
+                    ++failed;
+                    error = "failed to decode " + item->series->slices[item->z].filePath;
+                    // per-series files keep their geometry, the slice is left zero
+                    if (format != Format::Png) bytes = QByteArray(sliceBytes, '\0');
+                } else if (format == Format::Png) {
+                    lut.update(volume, windowCenter, windowWidth);
+                    // rows in stored order, like raw and NRRD (renderSlice flips them for display)
+                    const int w = volume.width();
+                    QImage image(w, volume.height(), QImage::Format_Grayscale8);
+                    for (int y = 0; y < volume.height(); ++y)
+                        lut.apply(item->pixels.get() + static_cast<std::size_t>(y) * w, image.scanLine(y), w);
+                    QBuffer buffer(&bytes);
+                    buffer.open(QIODevice::WriteOnly);
+                    image.save(&buffer, "PNG");
+                } else {
+                    bytes = QByteArray(reinterpret_cast<const char*>(item->pixels.get()), sliceBytes);
+                }
+                if (format == Format::Nrrd)
+                    std::call_once(item->series->headerBuilt, [&] { item->series->header = nrrdHeader(*item->series, volume); });
+                else if (format == Format::Raw)
+                    std::call_once(item->series->headerBuilt, [&] {
+                        item->series->rawName = rawFileName(*item->series, volume);
+                        item->series->rawInfo = rawSidecar(volume);
+                    });
+
+                Series* s = item->series;
+                const int z = item->z;
+                item.reset();
+                // the last slice of a series releases its volume
+                if (--s->pending == 0) s->volume.reset();
+                encoded.push({s, z, std::move(bytes), std::move(error)});
+            }
+            if (--encodersLeft == 0) encoded.close();
+        });
+    }
+
+    // writer: sequential I/O on this thread
+    int done = 0;
+    while (auto item = encoded.pop()) {
+        Series& s = *item->series;
+        const int depth = static_cast<int>(s.slices.size());
+        ++done;
+        if (!item->error.isEmpty()) err() << item->error << "\n";
+        if (item->bytes.isEmpty()) continue;
+
+        if (format == Format::Png) {
+            QFile f(outputDir.filePath(QString("%1/%2.png").arg(s.name).arg(item->z, 4, 10, QChar('0'))));
+            if (!f.open(QIODevice::WriteOnly) || f.write(item->bytes) != item->bytes.size()) {
+                err() << "cannot write " << f.fileName() << "\n";
+                ++failed;
+            }
+            continue;
+        }
+
+        if (!s.file) {
+            const QString fileName = format == Format::Nrrd ? s.name + ".nrrd" : s.rawName;
+            s.file = std::make_unique<QFile>(outputDir.filePath(fileName));
+            QString failedName;
+            if (!s.file->open(QIODevice::WriteOnly) || s.file->write(s.header) != s.header.size())
+                failedName = s.file->fileName();
+            if (failedName.isEmpty() && format == Format::Raw) {
+                QFile info(outputDir.filePath(fileName.chopped(4) + ".txt"));
+                if (!info.open(QIODevice::WriteOnly) || info.write(s.rawInfo) != s.rawInfo.size())
+                    failedName = info.fileName();
+            }
+            if (!failedName.isEmpty()) {
+                err() << "cannot write " << failedName << "\n";
+                // stop the pipeline, the pool threads are blocked on the queues otherwise
+                decoded.close();
+                encoded.close();
+                pool.waitForDone();
+                return 1;
+            }
+        }
+        // slices finish out of order; each one has a fixed place in the file
+        s.file->seek(s.header.size() + static_cast<qint64>(item->z) * item->bytes.size());
+        if (s.file->write(item->bytes) != item->bytes.size()) {
+            err() << "cannot write " << s.file->fileName() << "\n";
+            ++failed;
+        }
+        if (++s.written == depth) {
+            s.file->close();
+            s.file.reset();
+        }
+    }
+    pool.waitForDone();
+
+    const double seconds = convert.nsecsElapsed() / 1e9;
+    out() << QString("Converted %1 slices of %2 series in %3 s (%4 slices/s, %5 failed)\n")
+        .arg(done).arg(series.size())
+        .arg(seconds, 0, 'f', 2)
+        .arg(seconds > 0.0 ? done / seconds : 0.0, 0, 'f', 1)
+        .arg(failed.load());
+    return failed.load() == 0 ? 0 : 2;
+}